@@ -489,6 +489,21 @@ bool SaveToFile(LPCVOID data, DWORD length, const string_t& path,
   return result != FALSE;
 }
 
+// The data is written to a temporary file first, so that an incomplete file
+// never takes the place of the original one.
+bool SaveToFileAtomic(LPCVOID data, DWORD length, const std::wstring& path) {
+  std::wstring temp_path = path + L".tmp";
+
+  if (!SaveToFile(data, length, temp_path) ||
+      !MoveFileEx(temp_path.c_str(), path.c_str(),
+                  MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    DeleteFile(temp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 std::wstring ToSizeString(QWORD qwSize) {
@@ -25,6 +25,9 @@
 
 #include "types.h"
 
+HANDLE OpenFileForGenericRead(const std::wstring& path);
+HANDLE OpenFileForGenericWrite(const std::wstring& path);
+
 unsigned long GetFileAge(const std::wstring& path);
 QWORD GetFileSize(const std::wstring& path);
 QWORD GetFolderSize(const std::wstring& path, bool recursive);
@@ -52,6 +55,7 @@ int PopulateFolders(std::vector<std::wstring>& folder_list, const std::wstring&
 
 bool ReadFromFile(const std::wstring& path, std::string& output);
 bool SaveToFile(LPCVOID data, DWORD length, const std::wstring& path, bool take_backup = false);
+bool SaveToFileAtomic(LPCVOID data, DWORD length, const std::wstring& path);
 
 std::wstring ToSizeString(QWORD qwSize);
 
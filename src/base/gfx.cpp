@@ -30,6 +30,13 @@ Image::Image()
 }
 
 bool Image::Load(const std::wstring& path) {
+  win::Rect rect;
+  HBITMAP hbmp = DecodeImage(path, rect);
+
+  return Load(hbmp, rect);
+}
+
+bool Image::Load(HBITMAP hbmp, const win::Rect& rect) {
   ::DeleteObject(dc.DetachBitmap());
   
   if (dc.Get() == nullptr) {
@@ -38,6 +45,18 @@ bool Image::Load(const std::wstring& path) {
     ::ReleaseDC(NULL, hScreen);
   }
 
+  this->rect = rect;
+
+  if (!hbmp) {
+    ::DeleteDC(dc.DetachDc());
+    return false;
+  }
+
+  dc.AttachBitmap(hbmp);
+  return true;
+}
+
+HBITMAP DecodeImage(const std::wstring& path, win::Rect& rect) {
   Gdiplus::Bitmap bmp(path.c_str());
   rect.right = bmp.GetWidth();
   rect.bottom = bmp.GetHeight();
@@ -47,12 +66,10 @@ bool Image::Load(const std::wstring& path) {
 
   if (!hbmp || !rect.right || !rect.bottom) {
     ::DeleteObject(hbmp);
-    ::DeleteDC(dc.DetachDc());
-    return false;
+    return nullptr;
   }
 
-  dc.AttachBitmap(hbmp);
-  return true;
+  return hbmp;
 }
 
 }  // namespace base
@@ -32,12 +32,17 @@ public:
   virtual ~Image() {}
 
   bool Load(const std::wstring& file);
+  bool Load(HBITMAP bitmap, const win::Rect& rect);
 
   win::Dc dc;
   win::Rect rect;
   LPARAM data;
 };
 
+// Decodes an image file into a new bitmap. Unlike Image::Load, this does not
+// touch any device context, so it is safe to call from worker threads.
+HBITMAP DecodeImage(const std::wstring& file, win::Rect& rect);
+
 }  // namespace base
 
 HFONT ChangeDCFont(HDC hdc, LPCWSTR lpFaceName, INT iSize, BOOL bBold, BOOL bItalic, BOOL bUnderline);
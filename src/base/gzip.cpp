@@ -44,35 +44,78 @@ bool UncompressGzippedFile(const std::string& file, std::string& output) {
 }
 
 bool UncompressGzippedString(const std::string& input, std::string& output) {
-  z_stream stream;
-  stream.zalloc = Z_NULL;
-  stream.zfree = Z_NULL;
-  stream.opaque = NULL;
-  stream.total_out = 0;
-  stream.next_in = (BYTE*)&input[0];
-  stream.avail_in = input.length();
-
-  if (inflateInit2(&stream, MAX_WBITS + 32) != Z_OK)
-    return false;
+  GzipDecoder decoder;
+
+  return decoder.Decode(input.data(), input.size(), output) &&
+         decoder.finished();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GzipDecoder::GzipDecoder()
+    : finished_(false),
+      stream_(nullptr) {
+}
 
-  size_t buffer_length = input.length() * 2;
-  char* buffer = (char*)GlobalAlloc(GMEM_ZEROINIT, buffer_length);
+GzipDecoder::~GzipDecoder() {
+  Reset();
+}
+
+bool GzipDecoder::Decode(const char* data, size_t size, std::string& output) {
+  if (finished_)
+    return true;
+
+  if (!stream_) {
+    stream_ = new z_stream;
+    ZeroMemory(stream_, sizeof(z_stream));
+    // Automatic detection of gzip and zlib headers
+    if (inflateInit2(stream_, MAX_WBITS + 32) != Z_OK) {
+      delete stream_;
+      stream_ = nullptr;
+      return false;
+    }
+  }
 
-  size_t total_length = 0;
-  int status = Z_OK;
+  stream_->next_in = (Bytef*)data;
+  stream_->avail_in = static_cast<uInt>(size);
+
+  char buffer[16384];
 
   do {
-    stream.next_out = (BYTE*)buffer;
-    stream.avail_out = buffer_length;
-    status = inflate(&stream, Z_SYNC_FLUSH);
-    if (status == Z_OK || status == Z_STREAM_END) {
-      output.append(buffer, stream.total_out - total_length);
-      total_length = stream.total_out;
+    stream_->next_out = (Bytef*)buffer;
+    stream_->avail_out = sizeof(buffer);
+
+    int status = inflate(stream_, Z_NO_FLUSH);
+    switch (status) {
+      case Z_OK:
+      case Z_BUF_ERROR:  // Not an error, more input is needed
+        break;
+      case Z_STREAM_END:
+        finished_ = true;
+        break;
+      default:
+        return false;
     }
-  } while (status == Z_OK);
 
-  GlobalFree(buffer);
-  inflateEnd(&stream);
+    output.append(buffer, sizeof(buffer) - stream_->avail_out);
+
+    if (finished_ || status == Z_BUF_ERROR)
+      break;
+  } while (stream_->avail_in > 0 || stream_->avail_out == 0);
+
+  return true;
+}
+
+bool GzipDecoder::finished() const {
+  return finished_;
+}
+
+void GzipDecoder::Reset() {
+  if (stream_) {
+    inflateEnd(stream_);
+    delete stream_;
+    stream_ = nullptr;
+  }
 
-  return status == Z_STREAM_END;
+  finished_ = false;
 }
\ No newline at end of file
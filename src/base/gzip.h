@@ -21,6 +21,30 @@
 
 #include <string>
 
+struct z_stream_s;
+
+// Decompresses gzip or zlib data that arrives in chunks, so that it can be
+// decoded as it is received.
+
+class GzipDecoder {
+public:
+  GzipDecoder();
+  ~GzipDecoder();
+
+  // Appends decompressed data to the output. Data that follows the end of the
+  // compressed stream is ignored.
+  bool Decode(const char* data, size_t size, std::string& output);
+  bool finished() const;
+  void Reset();
+
+private:
+  GzipDecoder(const GzipDecoder&);
+  GzipDecoder& operator=(const GzipDecoder&);
+
+  bool finished_;
+  z_stream_s* stream_;
+};
+
 bool UncompressGzippedFile(const std::string& file, std::string& output);
 bool UncompressGzippedString(const std::string& input, std::string& output);
 
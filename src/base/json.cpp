@@ -29,4 +29,277 @@ bool JsonReadArray(const Json::Value& root, const std::string& name,
     output.push_back(StrToWstr(value[i].asString()));
 
   return output.size() > previous_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+JsonReader::JsonReader(const std::wstring& text)
+    : current_(text.data()),
+      end_(text.data() + text.size()),
+      error_(false) {
+}
+
+bool JsonReader::error() const {
+  return error_;
+}
+
+bool JsonReader::BeginArray() {
+  return Begin(L'[');
+}
+
+bool JsonReader::BeginObject() {
+  return Begin(L'{');
+}
+
+bool JsonReader::NextElement() {
+  SkipWhitespace();
+  if (current_ < end_ && *current_ == L',') {
+    ++current_;
+    SkipWhitespace();
+  }
+
+  if (current_ == end_)
+    return Fail();
+  if (*current_ == L']') {
+    ++current_;
+    return false;
+  }
+
+  return true;
+}
+
+bool JsonReader::NextName(std::wstring& name) {
+  SkipWhitespace();
+  if (current_ < end_ && *current_ == L',') {
+    ++current_;
+    SkipWhitespace();
+  }
+
+  if (current_ == end_)
+    return Fail();
+  if (*current_ == L'}') {
+    ++current_;
+    return false;
+  }
+  if (*current_ != L'"' || !ReadStringToken(name))
+    return Fail();
+
+  SkipWhitespace();
+  if (current_ == end_ || *current_ != L':')
+    return Fail();
+  ++current_;
+
+  return true;
+}
+
+bool JsonReader::ReadBool(bool& value) {
+  std::wstring text;
+  if (!ReadString(text))
+    return false;
+
+  value = text == L"true" || _wtoi(text.c_str()) != 0;
+  return true;
+}
+
+bool JsonReader::ReadInt(int& value) {
+  std::wstring text;
+  if (!ReadString(text))
+    return false;
+
+  value = text == L"true" ? 1 : _wtoi(text.c_str());
+  return true;
+}
+
+bool JsonReader::ReadString(std::wstring& value) {
+  value.clear();
+
+  SkipWhitespace();
+  if (current_ == end_)
+    return Fail();
+
+  switch (*current_) {
+    case L'"':
+      return ReadStringToken(value);
+    case L'[':
+    case L'{':
+      Skip();
+      return false;
+    default:
+      if (!ReadLiteral(value))
+        return false;
+      if (value == L"null")
+        value.clear();
+      return true;
+  }
+}
+
+bool JsonReader::Skip() {
+  SkipWhitespace();
+  if (current_ == end_)
+    return Fail();
+
+  if (*current_ == L'"')
+    return SkipStringToken();
+
+  if (*current_ != L'[' && *current_ != L'{') {
+    std::wstring value;
+    return ReadLiteral(value);
+  }
+
+  int depth = 0;
+  do {
+    if (current_ == end_)
+      return Fail();
+    switch (*current_) {
+      case L'"':
+        if (!SkipStringToken())
+          return false;
+        continue;
+      case L'[':
+      case L'{':
+        depth++;
+        break;
+      case L']':
+      case L'}':
+        depth--;
+        break;
+    }
+    ++current_;
+  } while (depth > 0);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool JsonReader::Begin(wchar_t c) {
+  SkipWhitespace();
+  if (current_ == end_)
+    return Fail();
+
+  if (*current_ == c) {
+    ++current_;
+    return true;
+  }
+
+  std::wstring value;
+  if (*current_ != L'"' && ReadLiteral(value) && value == L"null")
+    return false;
+
+  return Fail();
+}
+
+bool JsonReader::Fail() {
+  error_ = true;
+  current_ = end_;
+  return false;
+}
+
+bool JsonReader::ReadLiteral(std::wstring& value) {
+  const wchar_t* begin = current_;
+
+  while (current_ < end_) {
+    wchar_t c = *current_;
+    if (c == L',' || c == L']' || c == L'}' || c == L':' ||
+        c == L' ' || c == L'\t' || c == L'\r' || c == L'\n')
+      break;
+    ++current_;
+  }
+
+  if (current_ == begin)
+    return Fail();
+
+  value.assign(begin, current_);
+  return true;
+}
+
+bool JsonReader::ReadStringToken(std::wstring& value) {
+  value.clear();
+  ++current_;  // opening quote
+
+  while (current_ < end_) {
+    // Copy unescaped characters at once
+    const wchar_t* begin = current_;
+    while (current_ < end_ && *current_ != L'"' && *current_ != L'\\')
+      ++current_;
+    value.append(begin, current_);
+
+    if (current_ == end_)
+      break;
+    if (*current_ == L'"') {
+      ++current_;
+      return true;
+    }
+
+    if (++current_ == end_)
+      break;
+    switch (*current_++) {
+      case L'"': value.push_back(L'"'); break;
+      case L'\\': value.push_back(L'\\'); break;
+      case L'/': value.push_back(L'/'); break;
+      case L'b': value.push_back(L'\b'); break;
+      case L'f': value.push_back(L'\f'); break;
+      case L'n': value.push_back(L'\n'); break;
+      case L'r': value.push_back(L'\r'); break;
+      case L't': value.push_back(L'\t'); break;
+      case L'u': {
+        // Surrogate pairs are kept as they are, as we use UTF-16 as well
+        if (end_ - current_ < 4)
+          return Fail();
+        wchar_t code_point = 0;
+        for (int i = 0; i < 4; i++) {
+          wchar_t c = *current_++;
+          code_point <<= 4;
+          if (c >= L'0' && c <= L'9') {
+            code_point |= c - L'0';
+          } else if (c >= L'a' && c <= L'f') {
+            code_point |= c - L'a' + 10;
+          } else if (c >= L'A' && c <= L'F') {
+            code_point |= c - L'A' + 10;
+          } else {
+            return Fail();
+          }
+        }
+        value.push_back(code_point);
+        break;
+      }
+      default:
+        return Fail();
+    }
+  }
+
+  return Fail();
+}
+
+bool JsonReader::SkipStringToken() {
+  ++current_;  // opening quote
+
+  while (current_ < end_) {
+    switch (*current_++) {
+      case L'"':
+        return true;
+      case L'\\':
+        if (current_ < end_)
+          ++current_;
+        break;
+    }
+  }
+
+  return Fail();
+}
+
+void JsonReader::SkipWhitespace() {
+  while (current_ < end_) {
+    switch (*current_) {
+      case L' ':
+      case L'\t':
+      case L'\r':
+      case L'\n':
+      case 0xFEFF:  // byte order mark
+        ++current_;
+        break;
+      default:
+        return;
+    }
+  }
 }
\ No newline at end of file
@@ -26,4 +26,44 @@
 
 bool JsonReadArray(const Json::Value& root, const std::string& name, std::vector<std::wstring>& output);
 
+// Reads values one at a time from decoded text, without building a tree of
+// values. Arrays and objects are entered and iterated by the caller, and each
+// element must be either read or skipped. Once an error occurs, all reads fail.
+// The text must outlive the reader.
+
+class JsonReader {
+public:
+  JsonReader(const std::wstring& text);
+  ~JsonReader() {}
+
+  // Return false for null values, which are treated as empty
+  bool BeginArray();
+  bool BeginObject();
+
+  // Return false at the end of the current array or object
+  bool NextElement();
+  bool NextName(std::wstring& name);
+
+  // Values are converted from other types where possible, and null values are
+  // read as empty. Arrays and objects are skipped.
+  bool ReadBool(bool& value);
+  bool ReadInt(int& value);
+  bool ReadString(std::wstring& value);
+  bool Skip();
+
+  bool error() const;
+
+private:
+  bool Begin(wchar_t c);
+  bool Fail();
+  bool ReadLiteral(std::wstring& value);
+  bool ReadStringToken(std::wstring& value);
+  bool SkipStringToken();
+  void SkipWhitespace();
+
+  const wchar_t* current_;
+  const wchar_t* end_;
+  bool error_;
+};
+
 #endif  // TAIGA_BASE_JSON_H
\ No newline at end of file
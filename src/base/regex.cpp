@@ -0,0 +1,437 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cwctype>
+
+#include "regex.h"
+
+namespace base {
+
+// Guards against stack exhaustion with deeply nested groups
+static const int kMaxGroupDepth = 32;
+
+RegexSet::RegexSet()
+    : case_insensitive_(false) {
+}
+
+int RegexSet::Add(const std::wstring& pattern) {
+  if (starts_.size() >= kMaxPatterns)
+    return -1;
+
+  size_t class_count = classes_.size();
+  size_t state_count = states_.size();
+
+  size_t pos = 0;
+  Fragment fragment;
+  if (!ParseAlternation(pattern, pos, fragment, 0) || pos != pattern.size()) {
+    // Discard whatever was built before the error
+    classes_.resize(class_count);
+    states_.resize(state_count);
+    return -1;
+  }
+
+  int index = static_cast<int>(starts_.size());
+  Patch(fragment, AddState(kStateMatch, -1, -1, index));
+  starts_.push_back(fragment.start);
+
+  return index;
+}
+
+void RegexSet::Clear() {
+  classes_.clear();
+  starts_.clear();
+  states_.clear();
+}
+
+bool RegexSet::empty() const {
+  return starts_.empty();
+}
+
+size_t RegexSet::size() const {
+  return starts_.size();
+}
+
+bool RegexSet::case_insensitive() const {
+  return case_insensitive_;
+}
+
+void RegexSet::set_case_insensitive(bool enabled) {
+  case_insensitive_ = enabled;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UINT64 RegexSet::Match(const std::wstring& str) const {
+  UINT64 result = 0;
+
+  if (starts_.empty())
+    return result;
+
+  const UINT64 all = starts_.size() < kMaxPatterns ?
+      (static_cast<UINT64>(1) << starts_.size()) - 1 : ~static_cast<UINT64>(0);
+
+  // Each state is visited at most once per position, which keeps the
+  // simulation linear in the length of the input.
+  std::vector<size_t> marks(states_.size(), 0);
+  std::vector<int> current, pending, stack;
+  size_t generation = 0;
+
+  for (size_t i = 0; ; ++i) {
+    ++generation;
+    pending.clear();
+
+    stack = current;
+    for (size_t j = 0; j < starts_.size(); ++j)
+      if (!(result & (static_cast<UINT64>(1) << j)))
+        stack.push_back(starts_[j]);
+
+    while (!stack.empty()) {
+      int index = stack.back();
+      stack.pop_back();
+      if (index < 0 || marks[index] == generation)
+        continue;
+      marks[index] = generation;
+
+      const State& state = states_[index];
+      switch (state.type) {
+        case kStateClass:
+          pending.push_back(index);
+          break;
+        case kStateEpsilon:
+          stack.push_back(state.out);
+          break;
+        case kStateSplit:
+          stack.push_back(state.out1);
+          stack.push_back(state.out);
+          break;
+        case kStateLineBegin:
+          if (i == 0 || str.at(i - 1) == L'\n')
+            stack.push_back(state.out);
+          break;
+        case kStateLineEnd:
+          if (i == str.size() || str.at(i) == L'\n')
+            stack.push_back(state.out);
+          break;
+        case kStateMatch:
+          result |= static_cast<UINT64>(1) << state.value;
+          break;
+      }
+    }
+
+    if (result == all || i == str.size())
+      break;
+
+    current.clear();
+    wchar_t c = str.at(i);
+    for (size_t j = 0; j < pending.size(); ++j) {
+      const State& state = states_[pending[j]];
+      if (classes_[state.value].Contains(c, case_insensitive_))
+        current.push_back(state.out);
+    }
+  }
+
+  return result;
+}
+
+bool RegexSet::CharClass::Contains(wchar_t c, bool case_insensitive) const {
+  bool found = InRanges(c);
+
+  if (!found && case_insensitive)
+    found = InRanges(towlower(c)) || InRanges(towupper(c));
+
+  return found != negated;
+}
+
+bool RegexSet::CharClass::InRanges(wchar_t c) const {
+  for (size_t i = 0; i < ranges.size(); ++i)
+    if (c >= ranges[i].first && c <= ranges[i].second)
+      return true;
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int RegexSet::AddState(StateType type, int out, int out1, int value) {
+  State state;
+  state.type = type;
+  state.out = out;
+  state.out1 = out1;
+  state.value = value;
+  states_.push_back(state);
+
+  return static_cast<int>(states_.size()) - 1;
+}
+
+int RegexSet::AddClassState(const CharClass& char_class) {
+  classes_.push_back(char_class);
+
+  return AddState(kStateClass, -1, -1, static_cast<int>(classes_.size()) - 1);
+}
+
+void RegexSet::Patch(const Fragment& fragment, int state) {
+  for (size_t i = 0; i < fragment.outs.size(); ++i) {
+    State& out_state = states_[fragment.outs[i].first];
+    if (fragment.outs[i].second == 0) {
+      out_state.out = state;
+    } else {
+      out_state.out1 = state;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool RegexSet::ParseAlternation(const std::wstring& pattern, size_t& pos,
+                                Fragment& fragment, int depth) {
+  if (!ParseSequence(pattern, pos, fragment, depth))
+    return false;
+
+  while (pos < pattern.size() && pattern.at(pos) == L'|') {
+    ++pos;
+    Fragment alternative;
+    if (!ParseSequence(pattern, pos, alternative, depth))
+      return false;
+    fragment.start = AddState(kStateSplit, fragment.start, alternative.start, 0);
+    fragment.outs.insert(fragment.outs.end(),
+                         alternative.outs.begin(), alternative.outs.end());
+  }
+
+  return true;
+}
+
+bool RegexSet::ParseSequence(const std::wstring& pattern, size_t& pos,
+                             Fragment& fragment, int depth) {
+  // An empty sequence is valid, and matches the empty string
+  fragment.start = AddState(kStateEpsilon, -1, -1, 0);
+  fragment.outs.assign(1, std::make_pair(fragment.start, 0));
+
+  while (pos < pattern.size() &&
+         pattern.at(pos) != L'|' && pattern.at(pos) != L')') {
+    Fragment next;
+    if (!ParseRepetition(pattern, pos, next, depth))
+      return false;
+    Patch(fragment, next.start);
+    fragment.outs.swap(next.outs);
+  }
+
+  return true;
+}
+
+bool RegexSet::ParseRepetition(const std::wstring& pattern, size_t& pos,
+                               Fragment& fragment, int depth) {
+  if (!ParseAtom(pattern, pos, fragment, depth))
+    return false;
+
+  while (pos < pattern.size()) {
+    int split = -1;
+    switch (pattern.at(pos)) {
+      case L'*':
+        split = AddState(kStateSplit, fragment.start, -1, 0);
+        Patch(fragment, split);
+        fragment.start = split;
+        fragment.outs.assign(1, std::make_pair(split, 1));
+        break;
+      case L'+':
+        split = AddState(kStateSplit, fragment.start, -1, 0);
+        Patch(fragment, split);
+        fragment.outs.assign(1, std::make_pair(split, 1));
+        break;
+      case L'?':
+        split = AddState(kStateSplit, fragment.start, -1, 0);
+        fragment.start = split;
+        fragment.outs.push_back(std::make_pair(split, 1));
+        break;
+      default:
+        return true;
+    }
+    ++pos;
+    // Lazy quantifiers match the same strings, and we only care whether a
+    // match exists
+    if (pos < pattern.size() && pattern.at(pos) == L'?')
+      ++pos;
+  }
+
+  return true;
+}
+
+bool RegexSet::ParseAtom(const std::wstring& pattern, size_t& pos,
+                         Fragment& fragment, int depth) {
+  if (pos >= pattern.size() || depth > kMaxGroupDepth)
+    return false;
+
+  CharClass char_class;
+  wchar_t c = pattern.at(pos++);
+
+  switch (c) {
+    case L'(':
+      if (pattern.compare(pos, 2, L"?:") == 0)
+        pos += 2;
+      if (!ParseAlternation(pattern, pos, fragment, depth + 1))
+        return false;
+      if (pos >= pattern.size() || pattern.at(pos) != L')')
+        return false;
+      ++pos;
+      return true;
+    case L')':
+    case L'*':
+    case L'+':
+    case L'?':
+      return false;
+    case L'^':
+      fragment.start = AddState(kStateLineBegin, -1, -1, 0);
+      fragment.outs.assign(1, std::make_pair(fragment.start, 0));
+      return true;
+    case L'$':
+      fragment.start = AddState(kStateLineEnd, -1, -1, 0);
+      fragment.outs.assign(1, std::make_pair(fragment.start, 0));
+      return true;
+    case L'.':
+      char_class.ranges.push_back(std::make_pair(L'\n', L'\n'));
+      char_class.negated = true;
+      break;
+    case L'[':
+      if (!ParseClass(pattern, pos, char_class))
+        return false;
+      break;
+    case L'\\':
+      if (!ParseEscape(pattern, pos, char_class))
+        return false;
+      break;
+    default:
+      char_class.ranges.push_back(std::make_pair(c, c));
+      break;
+  }
+
+  fragment.start = AddClassState(char_class);
+  fragment.outs.assign(1, std::make_pair(fragment.start, 0));
+
+  return true;
+}
+
+bool RegexSet::ParseClass(const std::wstring& pattern, size_t& pos,
+                          CharClass& char_class) {
+  if (pos < pattern.size() && pattern.at(pos) == L'^') {
+    char_class.negated = true;
+    ++pos;
+  }
+
+  // A closing bracket right after the opening one is taken literally
+  bool first = true;
+
+  while (pos < pattern.size() && (pattern.at(pos) != L']' || first)) {
+    first = false;
+
+    wchar_t low = 0;
+    if (pattern.at(pos) == L'\\') {
+      ++pos;
+      CharClass escape;
+      if (!ParseEscape(pattern, pos, escape) || escape.negated)
+        return false;
+      if (escape.ranges.size() > 1 ||
+          escape.ranges.front().first != escape.ranges.front().second) {
+        // Shorthand classes cannot be the bounds of a range
+        char_class.ranges.insert(char_class.ranges.end(),
+                                 escape.ranges.begin(), escape.ranges.end());
+        continue;
+      }
+      low = escape.ranges.front().first;
+    } else {
+      low = pattern.at(pos++);
+    }
+
+    wchar_t high = low;
+    if (pos + 1 < pattern.size() &&
+        pattern.at(pos) == L'-' && pattern.at(pos + 1) != L']') {
+      ++pos;
+      if (pattern.at(pos) == L'\\') {
+        ++pos;
+        CharClass escape;
+        if (!ParseEscape(pattern, pos, escape) || escape.negated ||
+            escape.ranges.size() > 1 ||
+            escape.ranges.front().first != escape.ranges.front().second)
+          return false;
+        high = escape.ranges.front().first;
+      } else {
+        high = pattern.at(pos++);
+      }
+      if (high < low)
+        return false;
+    }
+
+    char_class.ranges.push_back(std::make_pair(low, high));
+  }
+
+  if (pos >= pattern.size())
+    return false;
+
+  ++pos;  // Skip the closing bracket
+
+  return true;
+}
+
+bool RegexSet::ParseEscape(const std::wstring& pattern, size_t& pos,
+                           CharClass& char_class) {
+  if (pos >= pattern.size())
+    return false;
+
+  wchar_t c = pattern.at(pos++);
+
+  switch (c) {
+    case L'd':
+    case L'D':
+      char_class.ranges.push_back(std::make_pair(L'0', L'9'));
+      char_class.negated = c == L'D';
+      break;
+    case L'w':
+    case L'W':
+      char_class.ranges.push_back(std::make_pair(L'0', L'9'));
+      char_class.ranges.push_back(std::make_pair(L'A', L'Z'));
+      char_class.ranges.push_back(std::make_pair(L'_', L'_'));
+      char_class.ranges.push_back(std::make_pair(L'a', L'z'));
+      char_class.negated = c == L'W';
+      break;
+    case L's':
+    case L'S':
+      char_class.ranges.push_back(std::make_pair(L'\t', L'\r'));
+      char_class.ranges.push_back(std::make_pair(L' ', L' '));
+      char_class.ranges.push_back(std::make_pair(L'\x3000', L'\x3000'));
+      char_class.negated = c == L'S';
+      break;
+    case L't':
+      char_class.ranges.push_back(std::make_pair(L'\t', L'\t'));
+      break;
+    case L'n':
+      char_class.ranges.push_back(std::make_pair(L'\n', L'\n'));
+      break;
+    case L'r':
+      char_class.ranges.push_back(std::make_pair(L'\r', L'\r'));
+      break;
+    default:
+      // Unknown escapes are reserved, so that they can be given a meaning
+      // later without changing the behavior of existing patterns
+      if (iswalnum(c))
+        return false;
+      char_class.ranges.push_back(std::make_pair(c, c));
+      break;
+  }
+
+  return true;
+}
+
+}  // namespace base
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_BASE_REGEX_H
+#define TAIGA_BASE_REGEX_H
+
+#include <windows.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace base {
+
+// A small regular expression engine that never backtracks. Patterns are
+// compiled into a nondeterministic automaton, which is then simulated over
+// the input, so matching is linear in the length of the input. Several
+// patterns can be compiled into the same set, and matched in a single scan.
+//
+// Supported syntax: literal characters, "." (any character), character
+// classes ("[a-z]", "[^0-9]"), escapes ("\d", "\w", "\s" and their negated
+// forms), anchors ("^", "$"), groups ("(...)", "(?:...)"), alternation ("|")
+// and the "*", "+" and "?" quantifiers. Patterns are not anchored unless
+// they say so, just like a search.
+
+class RegexSet {
+public:
+  RegexSet();
+  ~RegexSet() {}
+
+  static const size_t kMaxPatterns = 64;
+
+  // Returns the index of the new pattern, or -1 if the pattern is invalid or
+  // the set is full.
+  int Add(const std::wstring& pattern);
+  void Clear();
+  bool empty() const;
+  size_t size() const;
+
+  // Returns a mask of matching patterns, where bit i is set if pattern i
+  // matches somewhere in the string.
+  UINT64 Match(const std::wstring& str) const;
+
+  bool case_insensitive() const;
+  void set_case_insensitive(bool enabled);
+
+private:
+  enum StateType {
+    kStateClass,
+    kStateEpsilon,
+    kStateSplit,
+    kStateLineBegin,
+    kStateLineEnd,
+    kStateMatch
+  };
+
+  class State {
+  public:
+    StateType type;
+    int out;
+    int out1;
+    int value;  // Class index, or pattern index for match states
+  };
+
+  class CharClass {
+  public:
+    CharClass() : negated(false) {}
+    bool Contains(wchar_t c, bool case_insensitive) const;
+    bool InRanges(wchar_t c) const;
+
+    std::vector<std::pair<wchar_t, wchar_t>> ranges;
+    bool negated;
+  };
+
+  // A partially built automaton, with a list of unconnected exits
+  class Fragment {
+  public:
+    int start;
+    std::vector<std::pair<int, int>> outs;  // <state, slot>
+  };
+
+  int AddState(StateType type, int out, int out1, int value);
+  int AddClassState(const CharClass& char_class);
+  void Patch(const Fragment& fragment, int state);
+
+  bool ParseAlternation(const std::wstring& pattern, size_t& pos,
+                        Fragment& fragment, int depth);
+  bool ParseSequence(const std::wstring& pattern, size_t& pos,
+                     Fragment& fragment, int depth);
+  bool ParseRepetition(const std::wstring& pattern, size_t& pos,
+                       Fragment& fragment, int depth);
+  bool ParseAtom(const std::wstring& pattern, size_t& pos,
+                 Fragment& fragment, int depth);
+  bool ParseClass(const std::wstring& pattern, size_t& pos,
+                  CharClass& char_class);
+  bool ParseEscape(const std::wstring& pattern, size_t& pos,
+                   CharClass& char_class);
+
+  bool case_insensitive_;
+  std::vector<CharClass> classes_;
+  std::vector<int> starts_;
+  std::vector<State> states_;
+};
+
+}  // namespace base
+
+#endif  // TAIGA_BASE_REGEX_H
\ No newline at end of file
@@ -28,6 +28,14 @@ MyInformation::MyInformation()
       rewatching_ep(0) {
 }
 
+AiringInformation::AiringInformation()
+    : generation(0),
+      aired(false),
+      finished(false),
+      last_aired_episode(0),
+      estimated_episode_count(0) {
+}
+
 LocalInformation::LocalInformation()
     : last_aired_episode(0),
       playing(false),
@@ -84,6 +84,19 @@ class MyInformation {
   std::wstring tags;
 };
 
+// Date-dependent information, recalculated once a day (see AiringCalendar)
+class AiringInformation {
+ public:
+  AiringInformation();
+  virtual ~AiringInformation() {}
+
+  unsigned int generation;
+  bool aired;
+  bool finished;
+  int last_aired_episode;
+  int estimated_episode_count;
+};
+
 // For all kinds of other temporary information
 class LocalInformation {
  public:
@@ -0,0 +1,197 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/foreach.h"
+#include "library/anime.h"
+#include "library/anime_calendar.h"
+#include "library/anime_db.h"
+#include "library/anime_item.h"
+#include "library/anime_util.h"
+
+anime::AiringCalendar AiringCalendar;
+
+namespace anime {
+
+// Dates are compared with an approximation elsewhere, which cannot be used to
+// tell the day of the week. This counts the actual number of days since
+// 1970-01-01, a Thursday, in the proleptic Gregorian calendar.
+static int GetWeekday(const Date& date) {
+  int year = date.year - (date.month <= 2 ? 1 : 0);
+  int era = year / 400;
+  int year_of_era = year - era * 400;
+  int day_of_year = (153 * ((date.month + 9) % 12) + 2) / 5 + date.day - 1;
+  int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 +
+                   day_of_year;
+  int days = era * 146097 + day_of_era - 719468;
+
+  return (days % 7 + 11) % 7;  // 0 is Sunday
+}
+
+AiringCalendar::AiringCalendar()
+    : generation_(0), index_dirty_(true) {
+}
+
+bool AiringCalendar::Update() {
+  Date today = GetDateJapan();
+
+  win::Lock lock(critical_section);
+
+  if (generation_ && today == today_)
+    return false;
+
+  today_ = today;
+  generation_++;
+  index_dirty_ = true;
+
+  return true;
+}
+
+void AiringCalendar::Invalidate() {
+  win::Lock lock(critical_section);
+
+  index_dirty_ = true;
+}
+
+unsigned int AiringCalendar::generation() {
+  win::Lock lock(critical_section);
+
+  if (!generation_)
+    Update();
+
+  return generation_;
+}
+
+Date AiringCalendar::today() {
+  win::Lock lock(critical_section);
+
+  if (!generation_)
+    Update();
+
+  return today_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void AiringCalendar::Calculate(const Item& item, AiringInformation& info) {
+  win::Lock lock(critical_section);
+
+  info.generation = generation();
+
+  const Date& date_start = item.GetDateStart();
+  const Date& date_end = item.GetDateEnd();
+
+  // Aired yet?
+  if (item.GetAiringStatus(false) != kNotYetAired) {
+    info.aired = true;
+  } else if (!IsValidDate(date_start)) {
+    info.aired = false;
+  } else {
+    Date date = date_start;
+    // Assume the worst case
+    if (!date.month)
+      date.month = 12;
+    if (!date.day)
+      date.day = 31;
+    info.aired = today_ >= date;
+  }
+
+  // Finished airing?
+  if (item.GetAiringStatus(false) == kFinishedAiring) {
+    info.finished = true;
+  } else if (!IsValidDate(date_end) || !info.aired) {
+    info.finished = false;
+  } else {
+    info.finished = today_ > date_end;
+  }
+
+  // TV series air weekly, so the number of weeks that has passed since the day
+  // the series started airing gives us the last aired episode. Note that
+  // irregularities such as broadcasts being postponed due to sports events make
+  // this method unreliable.
+  info.last_aired_episode = 0;
+  if (item.GetType() == kTv &&
+      date_start.year && date_start.month && date_start.day) {
+    // To compensate for the fact that we don't know the airing hour,
+    // we substract one more day.
+    int date_diff = today_ - date_start - 1;
+    if (date_diff > -1) {
+      int number_of_weeks = date_diff / 7;
+      if (number_of_weeks < item.GetEpisodeCount()) {
+        info.last_aired_episode = number_of_weeks + 1;
+      } else {
+        info.last_aired_episode = item.GetEpisodeCount();
+      }
+    }
+  }
+
+  // Episode count, assuming the series is aired weekly
+  info.estimated_episode_count = 0;
+  if (item.GetType() == kTv && IsValidDate(date_start)) {
+    // Use current date in Japan if ending date is unknown
+    const Date& date = IsValidDate(date_end) ? date_end : today_;
+    info.estimated_episode_count = (date - date_start) / 7;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void AiringCalendar::GetAiringTitles(int day_offset,
+                                     std::vector<int>& anime_ids) {
+  win::Lock lock(critical_section);
+
+  // The index is rebuilt once after each day rollover, and whenever airing
+  // details have changed
+  if (index_dirty_ || !generation_)
+    BuildIndex();
+
+  int weekday = (GetWeekday(today_) + day_offset % 7 + 7) % 7;
+
+  foreach_(it, index_[weekday])
+    anime_ids.push_back(*it);
+}
+
+void AiringCalendar::GetAiringThisWeek(std::vector<int>& anime_ids) {
+  for (int i = 0; i < 7; i++)
+    GetAiringTitles(i, anime_ids);
+}
+
+void AiringCalendar::BuildIndex() {
+  generation();  // Makes sure the current day is known
+
+  for (int i = 0; i < 7; i++)
+    index_[i].clear();
+
+  // Start dates are the dates of broadcast in Japan, so series air on the
+  // same day of the week in Japan time as their first episode
+  foreach_(it, AnimeDatabase.items) {
+    const Item& item = it->second;
+    if (item.GetType() != kTv)
+      continue;
+    const Date& date_start = item.GetDateStart();
+    if (!date_start.year || !date_start.month || !date_start.day)
+      continue;
+    AiringInformation info = item.GetAiringInformation();
+    if (!info.aired || info.finished)
+      continue;
+    index_[GetWeekday(date_start)].push_back(item.GetId());
+  }
+
+  index_dirty_ = false;
+}
+
+}  // namespace anime
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_LIBRARY_ANIME_CALENDAR_H
+#define TAIGA_LIBRARY_ANIME_CALENDAR_H
+
+#include <vector>
+
+#include "base/time.h"
+#include "win/win_thread.h"
+
+namespace anime {
+
+class AiringInformation;
+class Item;
+
+// Airing estimates only change when the day changes in Japan, or when series
+// information is updated. Items cache their estimates along with the calendar's
+// generation, which is incremented at each day rollover, so that list redraws
+// and recognition do not have to recalculate them for each call. Feeds are
+// examined on connection threads, so the calendar and the estimates cached by
+// items are guarded by a lock.
+
+class AiringCalendar {
+public:
+  AiringCalendar();
+  ~AiringCalendar() {}
+
+  // Checks for day rollover, returns true if the day has changed.
+  bool Update();
+  // Called whenever airing details of an item are changed.
+  void Invalidate();
+
+  unsigned int generation();
+  Date today();
+
+  void Calculate(const Item& item, AiringInformation& info);
+
+  // Returns the IDs of currently airing TV series that are expected to air a
+  // new episode on the given day (0 is today, 1 is tomorrow, and so on).
+  void GetAiringTitles(int day_offset, std::vector<int>& anime_ids);
+  void GetAiringThisWeek(std::vector<int>& anime_ids);
+
+  win::CriticalSection critical_section;
+
+private:
+  void BuildIndex();
+
+  unsigned int generation_;
+  bool index_dirty_;
+  std::vector<int> index_[7];  // by weekday, 0 is Sunday
+  Date today_;
+};
+
+}  // namespace anime
+
+extern anime::AiringCalendar AiringCalendar;
+
+#endif  // TAIGA_LIBRARY_ANIME_CALENDAR_H
\ No newline at end of file
@@ -40,7 +40,19 @@ anime::Database AnimeDatabase;
 
 namespace anime {
 
+Database::Database()
+    : generation_(0) {
+}
+
+unsigned int Database::generation() const {
+  return generation_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool Database::LoadDatabase() {
+  generation_++;
+
   xml_document document;
   std::wstring path = taiga::GetPath(taiga::kPathDatabaseAnime);
   unsigned int options = pugi::parse_default & ~pugi::parse_eol;
@@ -227,6 +239,8 @@ Item* Database::FindSequel(int anime_id) {
 ////////////////////////////////////////////////////////////////////////////////
 
 void Database::ClearInvalidItems() {
+  generation_++;
+
   for (auto it = items.begin(); it != items.end(); ) {
     if (!it->second.GetId() || it->first != it->second.GetId()) {
       LOG(LevelDebug, L"ID: " + ToWstr(it->first));
@@ -238,6 +252,8 @@ void Database::ClearInvalidItems() {
 }
 
 int Database::UpdateItem(const Item& new_item) {
+  generation_++;
+
   Item* item = nullptr;
 
   for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
@@ -337,11 +353,77 @@ int Database::UpdateItem(const Item& new_item) {
   return item->GetId();
 }
 
+bool Database::HasChanges(const Item& item, const Item& new_item) const {
+  // Values that are compared here are the ones that UpdateItem would set
+  #define CHECK_VALUE(condition, old_value, new_value) \
+      if ((condition) && (old_value) != (new_value)) return true;
+
+  for (enum_t i = sync::kFirstService; i <= sync::kLastService; i++)
+    CHECK_VALUE(!new_item.GetId(i).empty(), item.GetId(i), new_item.GetId(i));
+  CHECK_VALUE(new_item.GetSource() != sync::kTaiga,
+              item.GetSource(), new_item.GetSource());
+
+  CHECK_VALUE(new_item.GetType() > 0,
+              item.GetType(), new_item.GetType());
+  CHECK_VALUE(new_item.GetEpisodeCount() > -1,
+              item.GetEpisodeCount(), new_item.GetEpisodeCount());
+  CHECK_VALUE(new_item.GetAiringStatus(false) > 0,
+              item.GetAiringStatus(false), new_item.GetAiringStatus());
+  CHECK_VALUE(!new_item.GetSlug().empty(),
+              item.GetSlug(), new_item.GetSlug());
+  CHECK_VALUE(!new_item.GetTitle().empty(),
+              item.GetTitle(), new_item.GetTitle());
+  CHECK_VALUE(!new_item.GetEnglishTitle(false).empty(),
+              item.GetEnglishTitle(false), new_item.GetEnglishTitle());
+  CHECK_VALUE(!new_item.GetSynonyms().empty(),
+              item.GetSynonyms(), new_item.GetSynonyms());
+  CHECK_VALUE(IsValidDate(new_item.GetDateStart()),
+              item.GetDateStart(), new_item.GetDateStart());
+  CHECK_VALUE(IsValidDate(new_item.GetDateEnd()),
+              item.GetDateEnd(), new_item.GetDateEnd());
+  CHECK_VALUE(!new_item.GetImageUrl().empty(),
+              item.GetImageUrl(), new_item.GetImageUrl());
+  CHECK_VALUE(!new_item.GetGenres().empty(),
+              item.GetGenres(), new_item.GetGenres());
+  CHECK_VALUE(!new_item.GetPopularity().empty(),
+              item.GetPopularity(), new_item.GetPopularity());
+  CHECK_VALUE(!new_item.GetProducers().empty(),
+              item.GetProducers(), new_item.GetProducers());
+  CHECK_VALUE(!new_item.GetScore().empty(),
+              item.GetScore(), new_item.GetScore());
+  CHECK_VALUE(!new_item.GetSynopsis().empty(),
+              item.GetSynopsis(), new_item.GetSynopsis());
+
+  if (new_item.IsInList()) {
+    if (!item.IsInList())
+      return true;
+    // MyAnimeList changes the last updated time along with the user's values,
+    // so this is usually where changed entries are found
+    CHECK_VALUE(true, item.GetMyLastUpdated(), new_item.GetMyLastUpdated());
+    CHECK_VALUE(true, item.GetMyLastWatchedEpisode(false),
+                new_item.GetMyLastWatchedEpisode(false));
+    CHECK_VALUE(true, item.GetMyScore(false), new_item.GetMyScore(false));
+    CHECK_VALUE(true, item.GetMyStatus(false), new_item.GetMyStatus(false));
+    CHECK_VALUE(true, item.GetMyRewatching(false),
+                new_item.GetMyRewatching(false));
+    CHECK_VALUE(true, item.GetMyRewatchingEp(), new_item.GetMyRewatchingEp());
+    CHECK_VALUE(true, item.GetMyDateStart(false),
+                new_item.GetMyDateStart(false));
+    CHECK_VALUE(true, item.GetMyDateEnd(false), new_item.GetMyDateEnd(false));
+    CHECK_VALUE(true, item.GetMyTags(false), new_item.GetMyTags(false));
+  }
+
+  #undef CHECK_VALUE
+
+  return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
 bool Database::LoadList() {
   ClearUserData();
+  generation_++;
 
   if (taiga::GetCurrentUsername().empty())
     return false;
@@ -469,6 +551,7 @@ void Database::AddToList(int anime_id, int status) {
   if (!anime_item)
     return;
 
+  generation_++;
   anime_item->AddtoUserList();
   SaveList();
 
@@ -486,6 +569,8 @@ void Database::AddToList(int anime_id, int status) {
 }
 
 void Database::ClearUserData() {
+  generation_++;
+
   ui::DlgAnimeList.SetCurrentId(ID_UNKNOWN);
 
   foreach_(it, items)
@@ -500,6 +585,7 @@ bool Database::DeleteListItem(int anime_id) {
   if (!anime_item->IsInList())
     return false;
 
+  generation_++;
   anime_item->RemoveFromUserList();
 
   ui::ChangeStatusText(L"Item deleted. (" + anime_item->GetTitle() + L")");
@@ -514,6 +600,8 @@ void Database::UpdateItem(const HistoryItem& history_item) {
   if (!anime_item)
     return;
 
+  generation_++;
+
   // Edit episode
   if (history_item.episode) {
     anime_item->SetMyLastWatchedEpisode(*history_item.episode);
@@ -548,9 +636,6 @@ void Database::UpdateItem(const HistoryItem& history_item) {
 
   SaveList();
 
-  History.queue.Remove();
-  History.queue.Check(false);
-
   ui::OnLibraryEntryChange(history_item.anime_id);
 }
 
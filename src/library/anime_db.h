@@ -33,6 +33,9 @@ namespace anime {
 
 class Database {
 public:
+  Database();
+  ~Database() {}
+
   bool LoadDatabase();
   bool SaveDatabase();
 
@@ -42,6 +45,9 @@ public:
 
   void ClearInvalidItems();
   int UpdateItem(const Item& item);
+  // Returns false if updating the item with the new one would not change
+  // anything other than its last modified time
+  bool HasChanges(const Item& item, const Item& new_item) const;
 
 public:
   bool LoadList();
@@ -54,6 +60,9 @@ public:
   bool DeleteListItem(int anime_id);
   void UpdateItem(const HistoryItem& history_item);
 
+  // Incremented whenever items are added, removed or updated in bulk
+  unsigned int generation() const;
+
 public:
   std::map<int, Item> items;
 
@@ -64,6 +73,8 @@ private:
   bool CheckOldUserDirectory();
   void ReadDatabaseInCompatibilityMode(pugi::xml_document& document);
   void ReadListInCompatibilityMode(pugi::xml_document& document);
+
+  unsigned int generation_;
 };
 
 }  // namespace anime
@@ -21,6 +21,7 @@
 #include "base/foreach.h"
 #include "base/string.h"
 #include "base/time.h"
+#include "library/anime_calendar.h"
 #include "library/anime_db.h"
 #include "library/anime_item.h"
 #include "library/anime_util.h"
@@ -193,6 +194,7 @@ void Item::SetSource(enum_t source) {
 
 void Item::SetType(int type) {
   metadata_.type = type;
+  InvalidateAiringInformation();
 }
 
 void Item::SetEpisodeCount(int number) {
@@ -200,6 +202,7 @@ void Item::SetEpisodeCount(int number) {
     metadata_.extent.resize(1);
 
   metadata_.extent.at(0) = number;
+  InvalidateAiringInformation();
 
   // TODO: Call it separately
   if (number >= 0)
@@ -216,6 +219,7 @@ void Item::SetEpisodeLength(int number) {
 
 void Item::SetAiringStatus(int status) {
   metadata_.status = status;
+  InvalidateAiringInformation();
 }
 
 void Item::SetTitle(const std::wstring& title) {
@@ -267,6 +271,7 @@ void Item::SetDateStart(const Date& date) {
     metadata_.date.resize(1);
 
   metadata_.date.at(0) = date;
+  InvalidateAiringInformation();
 }
 
 void Item::SetDateEnd(const Date& date) {
@@ -274,6 +279,7 @@ void Item::SetDateEnd(const Date& date) {
     metadata_.date.resize(2);
 
   metadata_.date.at(1) = date;
+  InvalidateAiringInformation();
 }
 
 void Item::SetImageUrl(const std::wstring& url) {
@@ -599,6 +605,24 @@ bool Item::UserSynonymsAvailable() const {
   return !local_info_.synonyms.empty();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+AiringInformation Item::GetAiringInformation() const {
+  win::Lock lock(AiringCalendar.critical_section);
+
+  if (airing_info_.generation != AiringCalendar.generation())
+    AiringCalendar.Calculate(*this, airing_info_);
+
+  return airing_info_;
+}
+
+void Item::InvalidateAiringInformation() {
+  win::Lock lock(AiringCalendar.critical_section);
+
+  airing_info_.generation = 0;
+  AiringCalendar.Invalidate();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
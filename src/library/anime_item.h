@@ -134,6 +134,9 @@ public:
   bool IsNewEpisodeAvailable() const;
   bool UserSynonymsAvailable() const;
 
+  // Calculated at most once a day, or after airing details are changed
+  AiringInformation GetAiringInformation() const;
+
   //////////////////////////////////////////////////////////////////////////////
   
   // A database item may not be in user's list.
@@ -142,8 +145,9 @@ public:
   void RemoveFromUserList();
 
 private:
-  // Helper function
+  // Helper functions
   HistoryItem* SearchHistory(int search_mode) const;
+  void InvalidateAiringInformation();
 
   // Series information, stored in db\anime.xml
   library::Metadata metadata_;
@@ -155,6 +159,9 @@ private:
   // Local information, stored temporarily
   LocalInformation local_info_;
 
+  // Airing information, cached for the current day
+  mutable AiringInformation airing_info_;
+
   // Pointer to the parent database which holds this item
   static Database* database_;
 };
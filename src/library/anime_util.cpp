@@ -41,62 +41,15 @@
 namespace anime {
 
 bool IsAiredYet(const Item& item) {
-  if (item.GetAiringStatus(false) != kNotYetAired)
-    return true;
-
-  if (!IsValidDate(item.GetDateStart()))
-    return false;
-  
-  Date date_japan = GetDateJapan();
-  Date date_start = item.GetDateStart();
-  
-  // Assume the worst case
-  if (!date_start.month)
-    date_start.month = 12;
-  if (!date_start.day)
-    date_start.day = 31;
-  
-  return date_japan >= date_start;
+  return item.GetAiringInformation().aired;
 }
 
 bool IsFinishedAiring(const Item& item) {
-  if (item.GetAiringStatus(false) == kFinishedAiring)
-    return true;
-
-  if (!IsValidDate(item.GetDateEnd()))
-    return false;
-
-  if (!IsAiredYet(item))
-    return false;
-
-  return GetDateJapan() > item.GetDateEnd();
+  return item.GetAiringInformation().finished;
 }
 
 int EstimateLastAiredEpisodeNumber(const Item& item) {
-  // Can't estimate for other types of anime
-  if (item.GetType() != kTv)
-    return 0;
-
-  // TV series air weekly, so the number of weeks that has passed since the day
-  // the series started airing gives us the last aired episode. Note that
-  // irregularities such as broadcasts being postponed due to sports events make
-  // this method unreliable.
-  const Date& date_start = item.GetDateStart();
-  if (date_start.year && date_start.month && date_start.day) { 
-    // To compensate for the fact that we don't know the airing hour,
-    // we substract one more day.
-    int date_diff = GetDateJapan() - date_start - 1;
-    if (date_diff > -1) {
-      int number_of_weeks = date_diff / 7;
-      if (number_of_weeks < item.GetEpisodeCount()) {
-        return number_of_weeks + 1;
-      } else {
-        return item.GetEpisodeCount();
-      }
-    }
-  }
-
-  return 0;
+  return item.GetAiringInformation().last_aired_episode;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -635,16 +588,7 @@ int EstimateEpisodeCount(const Item& item) {
                  item.GetAvailableEpisodeCount());
 
   // Estimate using airing dates of TV series
-  if (item.GetType() == kTv) {
-    Date date_start = item.GetDateStart();
-    if (IsValidDate(date_start)) {
-      Date date_end = item.GetDateEnd();
-      // Use current date in Japan if ending date is unknown
-      if (!IsValidDate(date_end)) date_end = GetDateJapan();
-      // Assuming the series is aired weekly
-      number = max(number, (date_end - date_start) / 7);
-    }
-  }
+  number = max(number, item.GetAiringInformation().estimated_episode_count);
 
   // Given all TV series aired since 2000, most them have their episodes
   // spanning one or two seasons. Following is a table of top ten values:
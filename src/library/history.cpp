@@ -33,9 +33,14 @@
 class ConfirmationQueue ConfirmationQueue;
 class History History;
 
+// Updates to different anime are sent at the same time, up to this limit.
+// Updates to the same anime are always sent in order, one at a time.
+const size_t kMaxSimultaneousUpdates = 4;
+
 HistoryItem::HistoryItem()
     : anime_id(anime::ID_UNKNOWN),
       enabled(true),
+      in_progress(false),
       mode(0) {
 }
 
@@ -90,36 +95,36 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
       break;
   }
 
-  // Edit previous item with the same ID...
+  // Edit previous item with the same ID, unless it is being sent...
   bool add_new_item = true;
-  if (!History.queue.updating) {
-    foreach_r_(it, items) {
-      if (it->anime_id == item.anime_id && it->enabled) {
-        if (it->mode != taiga::kHttpServiceAddLibraryEntry &&
-            it->mode != taiga::kHttpServiceDeleteLibraryEntry) {
-          if (!item.episode || (!it->episode && it == items.rbegin())) {
-            if (item.episode)
-              it->episode = *item.episode;
-            if (item.score)
-              it->score = *item.score;
-            if (item.status)
-              it->status = *item.status;
-            if (item.enable_rewatching)
-              it->enable_rewatching = *item.enable_rewatching;
-            if (item.tags)
-              it->tags = *item.tags;
-            if (item.date_start)
-              it->date_start = *item.date_start;
-            if (item.date_finish)
-              it->date_finish = *item.date_finish;
-            add_new_item = false;
-          }
-          if (!add_new_item) {
-            it->mode = taiga::kHttpServiceUpdateLibraryEntry;
-            it->time = (std::wstring)GetDate() + L" " + GetTime();
-          }
-          break;
+  foreach_r_(it, items) {
+    if (it->anime_id == item.anime_id && it->enabled) {
+      if (it->in_progress)
+        break;
+      if (it->mode != taiga::kHttpServiceAddLibraryEntry &&
+          it->mode != taiga::kHttpServiceDeleteLibraryEntry) {
+        if (!item.episode || (!it->episode && it == items.rbegin())) {
+          if (item.episode)
+            it->episode = *item.episode;
+          if (item.score)
+            it->score = *item.score;
+          if (item.status)
+            it->status = *item.status;
+          if (item.enable_rewatching)
+            it->enable_rewatching = *item.enable_rewatching;
+          if (item.tags)
+            it->tags = *item.tags;
+          if (item.date_start)
+            it->date_start = *item.date_start;
+          if (item.date_finish)
+            it->date_finish = *item.date_finish;
+          add_new_item = false;
+        }
+        if (!add_new_item) {
+          it->mode = taiga::kHttpServiceUpdateLibraryEntry;
+          it->time = (std::wstring)GetDate() + L" " + GetTime();
         }
+        break;
       }
     }
   }
@@ -156,41 +161,10 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
 }
 
 void HistoryQueue::Check(bool automatic) {
-  // Check
-  if (items.empty()) {
-    return;
-  }
-  if (!items[index].enabled) {
-    LOG(LevelDebug, L"Item is disabled, removing...");
-    Remove(index, true, true, false);
-    Check();
-    return;
-  }
-  if (!Taiga.logged_in) {
-    items[index].reason = L"Not logged in";
-    return;
-  }
-  if (automatic && !Settings.GetBool(taiga::kApp_Option_EnableSync)) {
-    items[index].reason = L"Synchronization is disabled";
-    return;
-  }
+  // Items that could not be updated before are tried again
+  failed_ids_.clear();
 
-  // Compare ID with anime list
-  auto anime_item = AnimeDatabase.FindItem(items[index].anime_id);
-  if (!anime_item) {
-    LOG(LevelWarning, L"Item not found in list, removing... ID: " +
-                      ToWstr(items[index].anime_id));
-    Remove(index, true, true, false);
-    Check();
-    return;
-  }
-
-  // Update
-  History.queue.updating = true;
-  ui::ChangeStatusText(L"Updating list... (" + anime_item->GetTitle() + L")");
-  AnimeValues* anime_values = static_cast<AnimeValues*>(&items[index]);
-  sync::UpdateLibraryEntry(*anime_values, items[index].anime_id,
-      static_cast<taiga::HttpClientMode>(items[index].mode));
+  Process(automatic);
 }
 
 void HistoryQueue::Clear(bool save) {
@@ -203,6 +177,34 @@ void HistoryQueue::Clear(bool save) {
     history->Save();
 }
 
+void HistoryQueue::CompleteUpdate(int anime_id) {
+  // Items are applied and moved to history in the order they were added
+  for (size_t i = 0; i < items.size(); ) {
+    if (items[i].anime_id == anime_id && items[i].in_progress) {
+      AnimeDatabase.UpdateItem(items[i]);
+      Remove(static_cast<int>(i), false, false, true);
+    } else {
+      i++;
+    }
+  }
+
+  ui::OnHistoryChange();
+  history->Save();
+
+  Process(false);
+}
+
+void HistoryQueue::FailUpdate(int anime_id) {
+  foreach_(it, items)
+    if (it->anime_id == anime_id)
+      it->in_progress = false;
+
+  // Items are not sent again until the queue is checked
+  failed_ids_.insert(anime_id);
+
+  Process(false);
+}
+
 HistoryItem* HistoryQueue::FindItem(int anime_id, int search_mode) {
   for (auto it = items.rbegin(); it != items.rend(); ++it) {
     if (it->anime_id == anime_id && it->enabled) {
@@ -310,6 +312,106 @@ void HistoryQueue::RemoveDisabled(bool save, bool refresh) {
     history->Save();
 }
 
+void HistoryQueue::Process(bool automatic) {
+  // Remove items that cannot be sent
+  bool removed = false;
+  for (size_t i = 0; i < items.size(); ) {
+    if (!items[i].in_progress) {
+      if (!items[i].enabled) {
+        LOG(LevelDebug, L"Item is disabled, removing...");
+        Remove(static_cast<int>(i), false, false, false);
+        removed = true;
+        continue;
+      }
+      if (!AnimeDatabase.FindItem(items[i].anime_id)) {
+        LOG(LevelWarning, L"Item not found in list, removing... ID: " +
+                          ToWstr(items[i].anime_id));
+        Remove(static_cast<int>(i), false, false, false);
+        removed = true;
+        continue;
+      }
+    }
+    i++;
+  }
+  if (removed) {
+    ui::OnHistoryChange();
+    history->Save();
+  }
+
+  // Anime that have an update in progress
+  std::set<int> updating_ids;
+  foreach_(it, items)
+    if (it->in_progress)
+      updating_ids.insert(it->anime_id);
+  updating = !updating_ids.empty();
+
+  // Check
+  if (items.empty()) {
+    return;
+  }
+  if (!Taiga.logged_in) {
+    items[index].reason = L"Not logged in";
+    return;
+  }
+  if (automatic && !Settings.GetBool(taiga::kApp_Option_EnableSync)) {
+    items[index].reason = L"Synchronization is disabled";
+    return;
+  }
+
+  for (size_t i = 0; i < items.size(); i++) {
+    if (updating_ids.size() >= kMaxSimultaneousUpdates)
+      break;
+
+    HistoryItem& item = items[i];
+    if (updating_ids.count(item.anime_id) || failed_ids_.count(item.anime_id))
+      continue;
+
+    // Consecutive changes to the same anime are merged into a single request
+    HistoryItem values = item;
+    item.in_progress = true;
+    if (item.mode != taiga::kHttpServiceDeleteLibraryEntry) {
+      for (size_t j = i + 1; j < items.size(); j++) {
+        HistoryItem& next_item = items[j];
+        if (next_item.anime_id != item.anime_id)
+          continue;
+        if (next_item.mode != taiga::kHttpServiceUpdateLibraryEntry)
+          break;
+        if (next_item.episode)
+          values.episode = *next_item.episode;
+        if (next_item.score)
+          values.score = *next_item.score;
+        if (next_item.status)
+          values.status = *next_item.status;
+        if (next_item.enable_rewatching)
+          values.enable_rewatching = *next_item.enable_rewatching;
+        if (next_item.tags)
+          values.tags = *next_item.tags;
+        if (next_item.date_start)
+          values.date_start = *next_item.date_start;
+        if (next_item.date_finish)
+          values.date_finish = *next_item.date_finish;
+        next_item.in_progress = true;
+      }
+    }
+
+    // Update
+    auto anime_item = AnimeDatabase.FindItem(item.anime_id);
+    ui::ChangeStatusText(L"Updating list... (" + anime_item->GetTitle() + L")");
+    AnimeValues* anime_values = static_cast<AnimeValues*>(&values);
+    if (!sync::UpdateLibraryEntry(*anime_values, values.anime_id,
+            static_cast<taiga::HttpClientMode>(values.mode))) {
+      foreach_(it, items)
+        if (it->anime_id == values.anime_id)
+          it->in_progress = false;
+      break;
+    }
+
+    updating_ids.insert(values.anime_id);
+  }
+
+  updating = !updating_ids.empty();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 History::History()
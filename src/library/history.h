@@ -19,6 +19,7 @@
 #ifndef TAIGA_LIBRARY_HISTORY_H
 #define TAIGA_LIBRARY_HISTORY_H
 
+#include <set>
 #include <string>
 #include <queue>
 #include <vector>
@@ -54,6 +55,7 @@ public:
   virtual ~HistoryItem() {}
 
   bool enabled;
+  bool in_progress;
   int anime_id;
   int mode;
   std::wstring reason;
@@ -70,6 +72,8 @@ public:
   void Add(HistoryItem& item, bool save = true);
   void Check(bool automatic = true);
   void Clear(bool save = true);
+  void CompleteUpdate(int anime_id);
+  void FailUpdate(int anime_id);
   HistoryItem* FindItem(int anime_id, int search_mode = 0);
   HistoryItem* GetCurrentItem();
   int GetItemCount();
@@ -80,6 +84,11 @@ public:
   std::vector<HistoryItem> items;
   History* history;
   bool updating;
+
+private:
+  void Process(bool automatic);
+
+  std::set<int> failed_ids_;
 };
 
 class History {
@@ -16,49 +16,85 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "base/crc.h"
 #include "base/file.h"
 #include "base/foreach.h"
+#include "base/string.h"
+#include "base/xml.h"
 #include "library/anime.h"
 #include "library/anime_db.h"
 #include "library/anime_util.h"
-#include "library/discover.h"
 #include "library/resource.h"
 #include "sync/sync.h"
 #include "taiga/path.h"
-#include "ui/dlg/dlg_anime_info.h"
-#include "ui/dlg/dlg_season.h"
+#include "ui/dlg/dlg_main.h"
+#include "ui/ui.h"
 
 anime::ImageDatabase ImageDatabase;
 
 namespace anime {
 
+// Decoded cover images are usually around 225x350 pixels, so this is enough for
+// a few hundred of them.
+const size_t kImageDatabaseMemoryLimit = 64 * 1024 * 1024;  // 64 MiB
+
+// Revalidation costs a single round trip when the image has not changed, so we
+// can afford to do it often.
+const time_t kImageRevalidationInterval = 60 * 60 * 24;  // 1 day
+
+static bool IsSameFile(const std::wstring& path, const std::wstring& other) {
+  std::string content, other_content;
+
+  if (!ReadFromFile(path, content) || !ReadFromFile(other, other_content))
+    return false;
+
+  return content == other_content;
+}
+
+ImageDatabaseStats::ImageDatabaseStats()
+    : hits(0), misses(0), evictions(0), resident_bytes(0) {
+}
+
+ImageDatabase::Entry::Entry()
+    : size(0) {
+}
+
+ImageDatabase::ImageDatabase()
+    : generation_(0), memory_limit_(kImageDatabaseMemoryLimit) {
+}
+
 bool ImageDatabase::Load(int anime_id, bool load, bool download) {
   if (anime_id <= anime::ID_UNKNOWN)
     return false;
 
-  if (items_.find(anime_id) != items_.end()) {
-    if (items_[anime_id].data > anime::ID_UNKNOWN) {
+  auto it = items_.find(anime_id);
+  if (it != items_.end()) {
+    Touch(it->second);
+    if (it->second.image.data > anime::ID_UNKNOWN) {
+      stats_.hits++;
       return true;
     } else if (!load) {
       return false;
     }
   }
 
-  if (items_[anime_id].Load(anime::GetImagePath(anime_id))) {
-    items_[anime_id].data = anime_id;
-    if (download) {
-      // Refresh if current file is too old
-      auto anime_item = AnimeDatabase.FindItem(anime_id);
-      if (anime_item->GetAiringStatus() != kFinishedAiring) {
-        // Check last modified date (>= 7 days)
-        if (GetFileAge(anime::GetImagePath(anime_id)) / (60 * 60 * 24) >= 7) {
-          sync::DownloadImage(anime_id, anime_item->GetImageUrl());
-        }
-      }
-    }
+  stats_.misses++;
+
+  Entry& entry = GetEntry(anime_id);
+  stats_.resident_bytes -= entry.size;
+  entry.size = 0;
+
+  if (entry.image.Load(anime::GetImagePath(anime_id))) {
+    entry.image.data = anime_id;
+    // GDI+ gives us a 32-bit bitmap
+    entry.size = entry.image.rect.Width() * entry.image.rect.Height() * 4;
+    stats_.resident_bytes += entry.size;
+    Trim();
+    if (download)
+      Download(anime_id);
     return true;
   } else {
-    items_[anime_id].data = -1;
+    entry.image.data = -1;
   }
 
   if (download) {
@@ -69,42 +105,576 @@ bool ImageDatabase::Load(int anime_id, bool load, bool download) {
   return false;
 }
 
-void ImageDatabase::FreeMemory() {
-  foreach_(it, ::AnimeDatabase.items) {
-    bool erase = true;
-    int anime_id = it->first;
-
-    if (items_.find(anime_id) == items_.end())
-      continue;
-
-    if (ui::DlgAnime.GetCurrentId() == anime_id ||
-        ui::DlgNowPlaying.GetCurrentId() == anime_id)
-      erase = false;
+bool ImageDatabase::Download(int anime_id) {
+  auto anime_item = AnimeDatabase.FindItem(anime_id);
+  if (!anime_item)
+    return false;
 
-    if (!SeasonDatabase.items.empty())
-      if (std::find(SeasonDatabase.items.begin(), SeasonDatabase.items.end(),
-                    anime_id) != SeasonDatabase.items.end())
-        if (ui::DlgSeason.IsVisible())
-          erase = false;
+  std::wstring path = anime::GetImagePath(anime_id);
 
-    if (erase)
-      items_.erase(anime_id);
+  // Revalidate if current file was not checked for a while
+  if (FileExists(path)) {
+    if (anime_item->GetAiringStatus() == kFinishedAiring)
+      return false;
+    ImageIndexItem index_item;
+    time_t age = index.Get(anime_id, index_item) ?
+        time(nullptr) - index_item.checked : GetFileAge(path);
+    if (age < kImageRevalidationInterval)
+      return false;
   }
+
+  sync::DownloadImage(anime_id, anime_item->GetImageUrl());
+  return true;
 }
 
 void ImageDatabase::Clear() {
+  // Results of pending requests are discarded when they arrive
+  decoder_.CancelAll();
+  generation_++;
+
+  index.Clear();
+
   items_.clear();
+  recently_used_.clear();
+  prefetched_.clear();
+  stats_.resident_bytes = 0;
 
   std::wstring path = taiga::GetPath(taiga::kPathDatabaseImage);
   DeleteFolder(path);
 }
 
 base::Image* ImageDatabase::GetImage(int anime_id) {
-  if (items_.find(anime_id) != items_.end())
-    if (items_[anime_id].data > 0)
-      return &items_[anime_id];
+  auto it = items_.find(anime_id);
+
+  if (it != items_.end()) {
+    if (it->second.image.data > 0) {
+      Touch(it->second);
+      return &it->second.image;
+    }
+  }
 
   return nullptr;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+bool ImageDatabase::Request(int anime_id, ImagePriority priority) {
+  if (anime_id <= anime::ID_UNKNOWN)
+    return false;
+
+  auto it = items_.find(anime_id);
+  if (it != items_.end()) {
+    Touch(it->second);
+    if (it->second.image.data > anime::ID_UNKNOWN) {
+      stats_.hits++;
+      return true;
+    } else {
+      return false;  // File is missing or could not be decoded
+    }
+  }
+
+  ImageDecodeRequest request;
+  request.anime_id = anime_id;
+  request.generation = generation_;
+  request.path = anime::GetImagePath(anime_id);
+
+  if (decoder_.Add(request, priority))
+    stats_.misses++;
+
+  return false;
+}
+
+void ImageDatabase::Prefetch(const std::vector<int>& anime_ids) {
+  // Images of the previous batch can be evicted again
+  prefetched_.clear();
+
+  foreach_(it, anime_ids) {
+    prefetched_.insert(*it);
+    if (items_.find(*it) == items_.end())
+      Request(*it, kImagePriorityPrefetch);
+  }
+}
+
+void ImageDatabase::Reload(int anime_id) {
+  if (anime_id <= anime::ID_UNKNOWN)
+    return;
+
+  // Images that are not in memory are decoded when they are requested
+  if (!items_.count(anime_id) && !pins_.count(anime_id))
+    return;
+
+  // The current image, if any, is displayed until the new one is decoded
+  ImageDecodeRequest request;
+  request.anime_id = anime_id;
+  request.generation = generation_;
+  request.path = anime::GetImagePath(anime_id);
+
+  decoder_.Add(request, kImagePriorityVisible);
+}
+
+void ImageDatabase::CancelRequests(ImagePriority priority) {
+  decoder_.Cancel(priority);
+}
+
+void ImageDatabase::OnDecodeComplete() {
+  std::vector<ImageDecodeResult> results;
+  decoder_.GetResults(results);
+
+  foreach_(it, results) {
+    if (it->generation != generation_) {
+      ::DeleteObject(it->bitmap);
+      continue;
+    }
+
+    // Prefetched images are inserted as the least recently used ones, so that
+    // they do not push out the images that are actually being displayed. They
+    // are kept out of eviction until the next batch, see Trim.
+    Entry& entry = GetEntry(it->anime_id,
+                            it->priority != kImagePriorityPrefetch);
+    stats_.resident_bytes -= entry.size;
+    entry.size = 0;
+
+    if (entry.image.Load(it->bitmap, it->rect)) {
+      entry.image.data = it->anime_id;
+      entry.size = entry.image.rect.Width() * entry.image.rect.Height() * 4;
+      stats_.resident_bytes += entry.size;
+      Trim();
+      ui::OnLibraryEntryImageChange(it->anime_id);
+    } else {
+      entry.image.data = -1;
+    }
+  }
+}
+
+void ImageDatabase::Shutdown() {
+  decoder_.Shutdown();
+  index.Save();
+}
+
+bool ImageDatabase::OnDownloadComplete(int anime_id,
+                                       const HttpResponse& response) {
+  std::wstring path = anime::GetImagePath(anime_id);
+  std::wstring temp_path = path + L".part";
+
+  ImageIndexItem item;
+  index.Get(anime_id, item);
+  item.checked = time(nullptr);
+
+  bool changed = false;
+
+  switch (response.code) {
+    case 200: {
+      item.etag.clear();
+      item.last_modified.clear();
+      foreach_(it, response.header) {
+        if (IsEqual(it->first, L"ETag")) {
+          item.etag = it->second;
+        } else if (IsEqual(it->first, L"Last-Modified")) {
+          item.last_modified = it->second;
+        }
+      }
+
+      std::wstring hash = CalculateCrcFromFile(temp_path);
+      QWORD size = GetFileSize(temp_path);
+
+      // Same content, e.g. the server does not support conditional requests
+      if (!hash.empty() && hash == item.hash &&
+          FileExists(path) && GetFileSize(path) == size) {
+        DeleteFile(temp_path.c_str());
+        break;
+      }
+
+      // Share the file with another item that has the same image. CRC32 is
+      // not enough to tell that two files are the same, so the contents are
+      // compared as well.
+      int other_id = index.FindByHash(hash, anime_id);
+      std::wstring other_path = anime::GetImagePath(other_id);
+      if (!hash.empty() && other_id > anime::ID_UNKNOWN &&
+          FileExists(other_path) && GetFileSize(other_path) == size &&
+          IsSameFile(temp_path, other_path)) {
+        DeleteFile(path.c_str());
+        if (CreateHardLink(path.c_str(), other_path.c_str(), nullptr)) {
+          DeleteFile(temp_path.c_str());
+          temp_path.clear();
+        }
+      }
+      // Replacing the file, instead of writing into it, keeps other links
+      // intact
+      if (!temp_path.empty())
+        MoveFileEx(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+
+      item.hash = hash;
+      changed = true;
+      break;
+    }
+
+    case 304:
+      // Not modified
+      break;
+
+    default:
+      DeleteFile(temp_path.c_str());
+      break;
+  }
+
+  index.Set(anime_id, item);
+
+  // Images in memory must only be touched on the UI thread
+  if (changed)
+    ui::DlgMain.PostMessage(WM_TAIGA_IMAGEDOWNLOADED, anime_id);
+
+  return changed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ImageDatabase::Pin(int anime_id) {
+  if (anime_id > anime::ID_UNKNOWN)
+    pins_[anime_id]++;
+}
+
+void ImageDatabase::Unpin(int anime_id) {
+  auto it = pins_.find(anime_id);
+
+  if (it != pins_.end() && --it->second <= 0) {
+    pins_.erase(it);
+    Trim();
+  }
+}
+
+size_t ImageDatabase::memory_limit() const {
+  return memory_limit_;
+}
+
+void ImageDatabase::set_memory_limit(size_t bytes) {
+  memory_limit_ = bytes;
+  Trim();
+}
+
+const ImageDatabaseStats& ImageDatabase::stats() const {
+  return stats_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ImageDatabase::Entry& ImageDatabase::GetEntry(int anime_id, bool recent) {
+  auto it = items_.find(anime_id);
+
+  if (it != items_.end()) {
+    if (recent)
+      Touch(it->second);
+    return it->second;
+  }
+
+  Entry& entry = items_[anime_id];  // Creates the entry
+  entry.position = recently_used_.insert(
+      recent ? recently_used_.begin() : recently_used_.end(), anime_id);
+  return entry;
+}
+
+void ImageDatabase::Touch(Entry& entry) {
+  recently_used_.splice(recently_used_.begin(), recently_used_,
+                        entry.position);
+}
+
+void ImageDatabase::Trim() {
+  if (recently_used_.empty())
+    return;
+
+  // The most recently used item is never evicted, as it may be in use
+  auto it = --recently_used_.end();
+
+  while (stats_.resident_bytes > memory_limit_ &&
+         it != recently_used_.begin()) {
+    int anime_id = *it;
+    auto current = it--;
+
+    if (pins_.count(anime_id) || prefetched_.count(anime_id))
+      continue;
+
+    auto item = items_.find(anime_id);
+    stats_.resident_bytes -= item->second.size;
+    if (item->second.size > 0)
+      stats_.evictions++;
+    items_.erase(item);
+    recently_used_.erase(current);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ImageIndexItem::ImageIndexItem()
+    : checked(0) {
+}
+
+ImageIndex::ImageIndex()
+    : loaded_(false), modified_(false) {
+}
+
+bool ImageIndex::Load() {
+  win::Lock lock(critical_section_);
+
+  if (loaded_)
+    return true;
+  loaded_ = true;
+
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseImageIndex);
+  xml_parse_result parse_result = document.load_file(path.c_str());
+
+  if (parse_result.status != pugi::status_ok)
+    return parse_result.status == pugi::status_file_not_found;
+
+  xml_node index_node = document.child(L"index");
+  foreach_xmlnode_(node, index_node, L"image") {
+    ImageIndexItem& item = items_[node.attribute(L"id").as_int()];
+    item.etag = node.attribute(L"etag").value();
+    item.last_modified = node.attribute(L"modified").value();
+    item.hash = node.attribute(L"hash").value();
+    item.checked = _wtoi64(node.attribute(L"checked").value());
+  }
+
+  return true;
+}
+
+bool ImageIndex::Save() {
+  win::Lock lock(critical_section_);
+
+  if (!modified_)
+    return true;
+
+  xml_document document;
+  xml_node index_node = document.append_child(L"index");
+
+  foreach_(it, items_) {
+    xml_node node = index_node.append_child(L"image");
+    node.append_attribute(L"id") = it->first;
+    if (!it->second.etag.empty())
+      node.append_attribute(L"etag") = it->second.etag.c_str();
+    if (!it->second.last_modified.empty())
+      node.append_attribute(L"modified") = it->second.last_modified.c_str();
+    node.append_attribute(L"hash") = it->second.hash.c_str();
+    node.append_attribute(L"checked") = ToWstr(it->second.checked).c_str();
+  }
+
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseImageIndex);
+  modified_ = false;
+  return XmlWriteDocumentToFile(document, path);
+}
+
+void ImageIndex::Clear() {
+  win::Lock lock(critical_section_);
+
+  items_.clear();
+  loaded_ = true;  // The file is deleted along with the images
+  modified_ = false;
+}
+
+bool ImageIndex::Get(int anime_id, ImageIndexItem& item) {
+  Load();
+
+  win::Lock lock(critical_section_);
+
+  auto it = items_.find(anime_id);
+  if (it == items_.end())
+    return false;
+
+  item = it->second;
+  return true;
+}
+
+void ImageIndex::Set(int anime_id, const ImageIndexItem& item) {
+  Load();
+
+  win::Lock lock(critical_section_);
+
+  items_[anime_id] = item;
+  modified_ = true;
+}
+
+int ImageIndex::FindByHash(const std::wstring& hash, int except_id) {
+  Load();
+
+  win::Lock lock(critical_section_);
+
+  foreach_(it, items_)
+    if (it->first != except_id && it->second.hash == hash)
+      return it->first;
+
+  return ID_UNKNOWN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ImageDecodeRequest::ImageDecodeRequest()
+    : anime_id(ID_UNKNOWN), generation(0), priority(kImagePriorityVisible) {
+}
+
+ImageDecodeResult::ImageDecodeResult()
+    : anime_id(ID_UNKNOWN), generation(0), priority(kImagePriorityVisible),
+      bitmap(nullptr) {
+}
+
+ImageDecoder::ImageDecoder()
+    : semaphore_(nullptr), sequence_(0), shutdown_(false) {
+  for (int i = 0; i < kWorkerCount; i++)
+    workers_[i].decoder = this;
+}
+
+ImageDecoder::~ImageDecoder() {
+  Shutdown();
+}
+
+bool ImageDecoder::Initialize() {
+  if (semaphore_)
+    return true;
+  if (shutdown_)
+    return false;
+
+  semaphore_ = ::CreateSemaphore(nullptr, 0, MAXLONG, nullptr);
+  if (!semaphore_)
+    return false;
+
+  for (int i = 0; i < kWorkerCount; i++)
+    workers_[i].CreateThread(nullptr, 0, 0);
+
+  return true;
+}
+
+void ImageDecoder::Shutdown() {
+  if (!semaphore_)
+    return;
+
+  {
+    win::Lock lock(critical_section_);
+    shutdown_ = true;
+    queue_.clear();
+    queued_.clear();
+  }
+
+  // Wake up all workers, so that they can see the shutdown flag
+  ::ReleaseSemaphore(semaphore_, kWorkerCount, nullptr);
+
+  for (int i = 0; i < kWorkerCount; i++) {
+    HANDLE thread = workers_[i].GetThreadHandle();
+    if (thread)
+      ::WaitForSingleObject(thread, INFINITE);
+    workers_[i].CloseThreadHandle();
+  }
+
+  ::CloseHandle(semaphore_);
+  semaphore_ = nullptr;
+
+  foreach_(it, results_)
+    ::DeleteObject(it->bitmap);
+  results_.clear();
+}
+
+bool ImageDecoder::Add(const ImageDecodeRequest& request,
+                       ImagePriority priority) {
+  if (!Initialize())
+    return false;
+
+  win::Lock lock(critical_section_);
+
+  if (decoding_.count(request.anime_id))
+    return false;
+
+  auto it = queued_.find(request.anime_id);
+  if (it != queued_.end()) {
+    if (it->second.first <= priority)
+      return false;  // Already queued with the same or a higher priority
+    queue_.erase(it->second);
+    queued_.erase(it);
+  }
+
+  key_t key(priority, sequence_++);
+  queue_[key] = request;
+  queue_[key].priority = priority;
+  queued_[request.anime_id] = key;
+
+  ::ReleaseSemaphore(semaphore_, 1, nullptr);
+  return true;
+}
+
+void ImageDecoder::Cancel(int anime_id) {
+  win::Lock lock(critical_section_);
+
+  auto it = queued_.find(anime_id);
+  if (it != queued_.end()) {
+    queue_.erase(it->second);
+    queued_.erase(it);
+  }
+}
+
+void ImageDecoder::Cancel(ImagePriority priority) {
+  win::Lock lock(critical_section_);
+
+  auto first = queue_.lower_bound(key_t(priority, 0));
+  auto last = queue_.lower_bound(key_t(priority + 1, 0));
+  for (auto it = first; it != last; ++it)
+    queued_.erase(it->second.anime_id);
+  queue_.erase(first, last);
+}
+
+void ImageDecoder::CancelAll() {
+  win::Lock lock(critical_section_);
+
+  queue_.clear();
+  queued_.clear();
+}
+
+void ImageDecoder::GetResults(std::vector<ImageDecodeResult>& results) {
+  win::Lock lock(critical_section_);
+
+  std::swap(results, results_);
+
+  foreach_(it, results)
+    decoding_.erase(it->anime_id);
+}
+
+bool ImageDecoder::WaitForRequest(ImageDecodeRequest& request) {
+  while (::WaitForSingleObject(semaphore_, INFINITE) == WAIT_OBJECT_0) {
+    win::Lock lock(critical_section_);
+
+    if (shutdown_)
+      return false;
+    if (queue_.empty())
+      continue;  // Request was cancelled
+
+    auto it = queue_.begin();
+    request = it->second;
+    queued_.erase(request.anime_id);
+    queue_.erase(it);
+    decoding_.insert(request.anime_id);
+    return true;
+  }
+
+  return false;
+}
+
+void ImageDecoder::AddResult(const ImageDecodeResult& result) {
+  {
+    win::Lock lock(critical_section_);
+    results_.push_back(result);
+  }
+
+  ui::DlgMain.PostMessage(WM_TAIGA_IMAGEDECODED);
+}
+
+DWORD ImageDecoder::Worker::ThreadProc() {
+  ImageDecodeRequest request;
+
+  while (decoder->WaitForRequest(request)) {
+    ImageDecodeResult result;
+    result.anime_id = request.anime_id;
+    result.generation = request.generation;
+    result.priority = request.priority;
+    result.bitmap = base::DecodeImage(request.path, result.rect);
+    decoder->AddResult(result);
+  }
+
+  return 0;
+}
+
 }  // namespace anime
\ No newline at end of file
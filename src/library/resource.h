@@ -19,29 +19,204 @@
 #ifndef TAIGA_LIBRARY_RESOURCE_H
 #define TAIGA_LIBRARY_RESOURCE_H
 
+#include <ctime>
+#include <list>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "base/gfx.h"
+#include "base/types.h"
+#include "win/win_thread.h"
 
 namespace anime {
 
+enum ImagePriority {
+  kImagePriorityVisible,
+  kImagePriorityPrefetch
+};
+
+class ImageDecodeRequest {
+public:
+  ImageDecodeRequest();
+
+  int anime_id;
+  unsigned int generation;
+  ImagePriority priority;
+  std::wstring path;
+};
+
+class ImageDecodeResult {
+public:
+  ImageDecodeResult();
+
+  int anime_id;
+  unsigned int generation;
+  ImagePriority priority;
+  HBITMAP bitmap;
+  win::Rect rect;
+};
+
+class ImageIndexItem {
+public:
+  ImageIndexItem();
+
+  std::wstring etag;
+  std::wstring last_modified;
+  std::wstring hash;
+  time_t checked;
+};
+
+// Keeps the HTTP validators and content hashes of downloaded images, so that
+// they can be revalidated with conditional requests. Accessed from both the UI
+// and HTTP threads.
+
+class ImageIndex {
+public:
+  ImageIndex();
+
+  bool Load();
+  bool Save();
+  void Clear();
+
+  bool Get(int anime_id, ImageIndexItem& item);
+  void Set(int anime_id, const ImageIndexItem& item);
+  int FindByHash(const std::wstring& hash, int except_id);
+
+private:
+  win::CriticalSection critical_section_;
+  std::map<int, ImageIndexItem> items_;
+  bool loaded_;
+  bool modified_;
+};
+
+// Decodes image files on a small pool of worker threads. Requests are served
+// by priority, then in the order they were added. Results are collected on the
+// UI thread after the main window is notified.
+
+class ImageDecoder {
+public:
+  ImageDecoder();
+  ~ImageDecoder();
+
+  void Shutdown();
+
+  bool Add(const ImageDecodeRequest& request, ImagePriority priority);
+  void Cancel(int anime_id);
+  void Cancel(ImagePriority priority);
+  void CancelAll();
+  void GetResults(std::vector<ImageDecodeResult>& results);
+
+private:
+  class Worker : public win::Thread {
+  public:
+    DWORD ThreadProc();
+    ImageDecoder* decoder;
+  };
+
+  typedef std::pair<int, unsigned int> key_t;  // priority, sequence
+
+  bool Initialize();
+  bool WaitForRequest(ImageDecodeRequest& request);
+  void AddResult(const ImageDecodeResult& result);
+
+  static const int kWorkerCount = 2;
+
+  win::CriticalSection critical_section_;
+  std::unordered_set<int> decoding_;
+  std::map<key_t, ImageDecodeRequest> queue_;
+  std::unordered_map<int, key_t> queued_;
+  std::vector<ImageDecodeResult> results_;
+  HANDLE semaphore_;
+  unsigned int sequence_;
+  bool shutdown_;
+  Worker workers_[kWorkerCount];
+};
+
+class ImageDatabaseStats {
+public:
+  ImageDatabaseStats();
+
+  unsigned int hits;
+  unsigned int misses;
+  unsigned int evictions;
+  size_t resident_bytes;
+};
+
+// Keeps decoded images in memory, within a fixed budget. Least recently used
+// images are evicted as soon as a new image would exceed the budget, except
+// for pinned images (e.g. the ones that are currently displayed).
+
 class ImageDatabase {
 public:
-  ImageDatabase() {}
+  ImageDatabase();
   virtual ~ImageDatabase() {}
 
   // Loads a picture into memory, downloads a new file if requested.
   bool Load(int anime_id, bool load, bool download);
 
-  // Releases image data from memory if an image is not in sight.
-  void FreeMemory();
+  // Downloads the file if it is missing or has not been revalidated for a
+  // while, without loading it into memory.
+  bool Download(int anime_id);
+
+  // Releases all image data from memory and deletes the files.
   void Clear();
 
   // Returns a pointer to requested image if available.
   base::Image* GetImage(int anime_id);
 
+  // Returns true if the image is already in memory. Otherwise the file is
+  // decoded in the background, and the UI is notified when it is ready. Until
+  // then, callers are expected to draw a placeholder.
+  bool Request(int anime_id, ImagePriority priority = kImagePriorityVisible);
+  // Prefetched images are not evicted until the next batch is prefetched,
+  // even though they are the least recently used ones.
+  void Prefetch(const std::vector<int>& anime_ids);
+  // Decodes the file again after it has been replaced.
+  void Reload(int anime_id);
+  void CancelRequests(ImagePriority priority);
+  void OnDecodeComplete();
+  void Shutdown();
+
+  // Called from the HTTP thread. Moves a downloaded file into place, unless
+  // the server or the content hash tells that the image has not changed.
+  // Returns true if the file on disk has changed, in which case the main
+  // window is notified, so that the image is reloaded on the UI thread.
+  bool OnDownloadComplete(int anime_id, const HttpResponse& response);
+
+  ImageIndex index;
+
+  // Pinned images are never evicted. Calls must be balanced.
+  void Pin(int anime_id);
+  void Unpin(int anime_id);
+
+  size_t memory_limit() const;
+  void set_memory_limit(size_t bytes);
+  const ImageDatabaseStats& stats() const;
+
 private:
-  std::map<int, base::Image> items_;
+  class Entry {
+  public:
+    Entry();
+
+    base::Image image;
+    size_t size;
+    std::list<int>::iterator position;
+  };
+
+  Entry& GetEntry(int anime_id, bool recent = true);
+  void Touch(Entry& entry);
+  void Trim();
+
+  std::unordered_map<int, Entry> items_;
+  std::list<int> recently_used_;  // most recently used item comes first
+  std::unordered_map<int, int> pins_;
+  std::unordered_set<int> prefetched_;
+  ImageDecoder decoder_;
+  unsigned int generation_;
+  size_t memory_limit_;
+  ImageDatabaseStats stats_;
 };
 
 }  // namespace anime
@@ -0,0 +1,204 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/crc.h"
+#include "base/file.h"
+#include "base/foreach.h"
+#include "base/string.h"
+#include "base/xml.h"
+#include "sync/cache.h"
+#include "taiga/path.h"
+
+sync::ResponseCache ResponseCache;
+
+namespace sync {
+
+// Responses can be used without making the request again for this long
+const time_t kMetadataLifetime = 60 * 60 * 6;  // 6 hours
+const time_t kSearchLifetime = 60 * 60;        // 1 hour
+
+// Expired responses are still shown while the request is being made again,
+// and they are used as a fallback when the request fails. Responses that are
+// older than that are removed.
+const time_t kStaleLifetime = 60 * 60 * 24 * 7;     // 1 week
+const time_t kMaximumLifetime = 60 * 60 * 24 * 30;  // 30 days
+
+static time_t GetLifetime(RequestType type) {
+  switch (type) {
+    case kGetMetadataById:
+      return kMetadataLifetime;
+    case kSearchTitle:
+      return kSearchLifetime;
+    default:
+      return 0;
+  }
+}
+
+std::wstring GetCacheKey(const Request& request) {
+  if (!GetLifetime(request.type))
+    return std::wstring();
+
+  std::wstring key = ToWstr(static_cast<int>(request.service_id)) + L"/" +
+                     ToWstr(static_cast<int>(request.type));
+
+  // Authentication data and our own IDs have nothing to do with the response
+  foreach_c_(it, request.data) {
+    if (it->first == L"taiga-id" ||
+        EndsWith(it->first, L"-username") ||
+        EndsWith(it->first, L"-password"))
+      continue;
+    std::wstring value = it->second;
+    if (it->first == L"title") {
+      Trim(value);
+      ToLower(value);
+    }
+    key += L"/" + it->first + L"=" + value;
+  }
+
+  return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResponseCacheItem::ResponseCacheItem()
+    : stored(0) {
+}
+
+ResponseCache::ResponseCache()
+    : loaded_(false), modified_(false) {
+}
+
+bool ResponseCache::Load() {
+  win::Lock lock(critical_section_);
+
+  if (loaded_)
+    return true;
+  loaded_ = true;
+
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseCacheIndex);
+  xml_parse_result parse_result = document.load_file(path.c_str());
+
+  if (parse_result.status != pugi::status_ok)
+    return parse_result.status == pugi::status_file_not_found;
+
+  time_t now = time(nullptr);
+  std::wstring folder = taiga::GetPath(taiga::kPathDatabaseCache);
+
+  xml_node index_node = document.child(L"index");
+  foreach_xmlnode_(node, index_node, L"response") {
+    ResponseCacheItem item;
+    item.file = node.attribute(L"file").value();
+    item.stored = _wtoi64(node.attribute(L"stored").value());
+    if (now - item.stored >= kMaximumLifetime) {
+      DeleteFile((folder + item.file).c_str());
+      modified_ = true;
+      continue;
+    }
+    items_[node.attribute(L"key").value()] = item;
+  }
+
+  return true;
+}
+
+bool ResponseCache::Save() {
+  win::Lock lock(critical_section_);
+
+  if (!modified_)
+    return true;
+
+  xml_document document;
+  xml_node index_node = document.append_child(L"index");
+
+  foreach_(it, items_) {
+    xml_node node = index_node.append_child(L"response");
+    node.append_attribute(L"key") = it->first.c_str();
+    node.append_attribute(L"file") = it->second.file.c_str();
+    node.append_attribute(L"stored") = ToWstr(it->second.stored).c_str();
+  }
+
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseCacheIndex);
+  modified_ = false;
+  return XmlWriteDocumentToFile(document, path);
+}
+
+CacheState ResponseCache::Get(const Request& request, std::wstring& body) {
+  std::wstring key = GetCacheKey(request);
+  if (key.empty())
+    return kCacheMiss;
+
+  Load();
+
+  win::Lock lock(critical_section_);
+
+  auto it = items_.find(key);
+  if (it == items_.end())
+    return kCacheMiss;
+
+  std::string data;
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseCache) +
+                      it->second.file;
+  if (!ReadFromFile(path, data)) {
+    items_.erase(it);
+    modified_ = true;
+    return kCacheMiss;
+  }
+  body = StrToWstr(data);
+
+  time_t age = time(nullptr) - it->second.stored;
+  time_t lifetime = GetLifetime(request.type);
+
+  if (age < lifetime)
+    return kCacheFresh;
+  if (age < lifetime + kStaleLifetime)
+    return kCacheStale;
+  return kCacheExpired;
+}
+
+void ResponseCache::Set(const Request& request, const std::wstring& body) {
+  std::wstring key = GetCacheKey(request);
+  if (key.empty())
+    return;
+
+  Load();
+
+  win::Lock lock(critical_section_);
+
+  ResponseCacheItem item;
+  item.file = CalculateCrcFromString(key);
+  item.stored = time(nullptr);
+
+  // Two keys can have the same checksum, in which case the older response is
+  // replaced
+  foreach_(it, items_) {
+    if (it->second.file == item.file && it->first != key) {
+      items_.erase(it);
+      break;
+    }
+  }
+
+  std::string data = WstrToStr(body);
+  std::wstring path = taiga::GetPath(taiga::kPathDatabaseCache) + item.file;
+  if (!SaveToFileAtomic(data.data(), data.size(), path))
+    return;
+
+  items_[key] = item;
+  modified_ = true;
+}
+
+}  // namespace sync
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_SYNC_CACHE_H
+#define TAIGA_SYNC_CACHE_H
+
+#include <ctime>
+#include <map>
+#include <string>
+#include "service.h"
+#include "win/win_thread.h"
+
+namespace sync {
+
+enum CacheState {
+  kCacheMiss,
+  kCacheFresh,    // Can be used as is
+  kCacheStale,    // Can be used while the request is made again
+  kCacheExpired   // Can only be used if the request fails
+};
+
+class ResponseCacheItem {
+public:
+  ResponseCacheItem();
+
+  std::wstring file;
+  time_t stored;
+};
+
+// Keeps the responses to metadata and search requests on disk, so that they
+// can be served without making the same requests again. Response bodies are
+// stored in separate files, while the index is kept in memory once it is
+// loaded. Accessed from both the UI and HTTP threads.
+
+class ResponseCache {
+public:
+  ResponseCache();
+
+  bool Load();
+  bool Save();
+
+  CacheState Get(const Request& request, std::wstring& body);
+  void Set(const Request& request, const std::wstring& body);
+
+private:
+  win::CriticalSection critical_section_;
+  std::map<std::wstring, ResponseCacheItem> items_;
+  bool loaded_;
+  bool modified_;
+};
+
+// Returns an empty string for requests whose responses are not cached
+std::wstring GetCacheKey(const Request& request);
+
+}  // namespace sync
+
+extern sync::ResponseCache ResponseCache;
+
+#endif  // TAIGA_SYNC_CACHE_H
\ No newline at end of file
@@ -16,6 +16,7 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "base/foreach.h"
 #include "base/json.h"
 #include "base/string.h"
 #include "library/anime_db.h"
@@ -159,77 +160,103 @@ void Service::AuthenticateUser(Response& response, HttpResponse& http_response)
 }
 
 void Service::GetLibraryEntries(Response& response, HttpResponse& http_response) {
-  Json::Value root;
-  Json::Reader reader;
-  bool parsed = reader.parse(WstrToStr(http_response.body), root);
+  JsonReader reader(http_response.body);
+  time_t current_time = time(nullptr);
+  std::wstring name, value, rating_type, rating_value;
+
+  if (reader.BeginArray()) {
+    while (reader.NextElement()) {
+      ::anime::Item anime_item;
+      anime_item.SetSource(this->id());
+      anime_item.SetLastModified(current_time);
+      anime_item.AddtoUserList();
+
+      rating_type.clear();
+      rating_value.clear();
+
+      if (!reader.BeginObject())
+        continue;
+      while (reader.NextName(name)) {
+        if (name == L"anime") {
+          ParseAnimeObject(reader, anime_item);
+        } else if (name == L"episodes_watched") {
+          int episodes_watched = 0;
+          reader.ReadInt(episodes_watched);
+          anime_item.SetMyLastWatchedEpisode(episodes_watched);
+        } else if (name == L"status") {
+          reader.ReadString(value);
+          anime_item.SetMyStatus(TranslateMyStatusFrom(value));
+        } else if (name == L"rewatching") {
+          bool rewatching = false;
+          reader.ReadBool(rewatching);
+          anime_item.SetMyRewatching(rewatching);
+        } else if (name == L"rating") {
+          if (reader.BeginObject()) {
+            while (reader.NextName(name)) {
+              if (name == L"type") {
+                reader.ReadString(rating_type);
+              } else if (name == L"value") {
+                reader.ReadString(rating_value);
+              } else {
+                reader.Skip();
+              }
+            }
+          }
+        } else {
+          reader.Skip();
+        }
+      }
 
-  if (!parsed) {
-    response.data[L"error"] = L"Could not parse the list";
-    return;
+      anime_item.SetMyScore(TranslateMyRatingFrom(rating_value, rating_type));
+
+      if (!anime_item.GetId(this->id()).empty())
+        response.items.push_back(anime_item);
+    }
   }
 
-  for (size_t i = 0; i < root.size(); i++) {
-    auto& value = root[i];
-    auto& anime_value = value["anime"];
-    auto& rating_value = value["rating"];
-
-    ::anime::Item anime_item;
-    anime_item.SetSource(this->id());
-    anime_item.SetId(StrToWstr(anime_value["slug"].asString()), this->id());
-    anime_item.SetLastModified(time(nullptr));  // current time
-
-    ParseAnimeObject(anime_value, anime_item);
-
-    anime_item.AddtoUserList();
-    anime_item.SetMyLastWatchedEpisode(value["episodes_watched"].asInt());
-    anime_item.SetMyStatus(TranslateMyStatusFrom(StrToWstr(value["status"].asString())));
-    anime_item.SetMyRewatching(value["rewatching"].asBool());
-    anime_item.SetMyScore(TranslateMyRatingFrom(StrToWstr(rating_value["value"].asString()),
-                                                StrToWstr(rating_value["type"].asString())));
-    
-    AnimeDatabase.UpdateItem(anime_item);
+  if (reader.error()) {
+    response.data[L"error"] = L"Could not parse the list";
+    response.items.clear();
   }
 }
 
 void Service::GetMetadataById(Response& response, HttpResponse& http_response) {
-  Json::Value root;
-  Json::Reader reader;
-  bool parsed = reader.parse(WstrToStr(http_response.body), root);
-
-  if (!parsed) {
-    response.data[L"error"] = L"Could not parse the anime object";
-    return;
-  }
+  JsonReader reader(http_response.body);
 
   ::anime::Item anime_item;
   anime_item.SetSource(this->id());
-  anime_item.SetId(StrToWstr(root["slug"].asString()), this->id());
   anime_item.SetLastModified(time(nullptr));  // current time
 
-  ParseAnimeObject(root, anime_item);
+  if (!ParseAnimeObject(reader, anime_item) || reader.error()) {
+    response.data[L"error"] = L"Could not parse the anime object";
+    return;
+  }
 
   AnimeDatabase.UpdateItem(anime_item);
 }
 
 void Service::SearchTitle(Response& response, HttpResponse& http_response) {
-  Json::Value root;
-  Json::Reader reader;
-  bool parsed = reader.parse(WstrToStr(http_response.body), root);
+  JsonReader reader(http_response.body);
+  time_t current_time = time(nullptr);
+  std::vector<anime::Item> anime_items;
+
+  if (reader.BeginArray()) {
+    while (reader.NextElement()) {
+      ::anime::Item anime_item;
+      anime_item.SetSource(this->id());
+      anime_item.SetLastModified(current_time);
+      if (ParseAnimeObject(reader, anime_item))
+        anime_items.push_back(anime_item);
+    }
+  }
 
-  if (!parsed) {
+  if (reader.error()) {
     response.data[L"error"] = L"Could not parse search results";
     return;
   }
 
-  for (size_t i = 0; i < root.size(); i++) {
-    ::anime::Item anime_item;
-    anime_item.SetSource(this->id());
-    anime_item.SetId(StrToWstr(root[i]["slug"].asString()), this->id());
-    anime_item.SetLastModified(time(nullptr));  // current time
-
-    ParseAnimeObject(root[i], anime_item);
-
-    int anime_id = AnimeDatabase.UpdateItem(anime_item);
+  foreach_(anime_item, anime_items) {
+    int anime_id = AnimeDatabase.UpdateItem(*anime_item);
 
     // We return a list of IDs so that we can display the results afterwards
     AppendString(response.data[L"ids"], ToWstr(anime_id), L",");
@@ -272,12 +299,21 @@ bool Service::RequestSucceeded(Response& response,
 
     // Error
     default: {
-      Json::Value root;
-      Json::Reader reader;
-      bool parsed = reader.parse(WstrToStr(http_response.body), root);
+      std::wstring error;
+      JsonReader reader(http_response.body);
+      if (reader.BeginObject()) {
+        std::wstring name;
+        while (reader.NextName(name)) {
+          if (name == L"error") {
+            reader.ReadString(error);
+          } else {
+            reader.Skip();
+          }
+        }
+      }
       response.data[L"error"] = name() + L" returned an error: ";
-      if (parsed) {
-        response.data[L"error"] += StrToWstr(root["error"].asString());
+      if (!reader.error()) {
+        response.data[L"error"] += error;
       } else {
         response.data[L"error"] += L"Unknown error (" +
             ToWstr(static_cast<int>(http_response.code)) + L")";
@@ -289,23 +325,66 @@ bool Service::RequestSucceeded(Response& response,
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void Service::ParseAnimeObject(Json::Value& value, anime::Item& anime_item) {
-  anime_item.SetSlug(StrToWstr(value["slug"].asString()));
-  anime_item.SetAiringStatus(TranslateSeriesStatusFrom(StrToWstr(value["status"].asString())));
-  anime_item.SetTitle(StrToWstr(value["title"].asString()));
-  anime_item.SetSynonyms(StrToWstr(value["alternate_title"].asString()));
-  anime_item.SetEpisodeCount(value["episode_count"].asInt());
-  anime_item.SetImageUrl(StrToWstr(value["cover_image"].asString()));
-  anime_item.SetSynopsis(StrToWstr(value["synopsis"].asString()));
-  anime_item.SetType(TranslateSeriesTypeFrom(StrToWstr(value["show_type"].asString())));
+// Reads the fields that we use, and skips the rest. The ID is the slug of the
+// anime. Returns false if the value is not an object.
+bool Service::ParseAnimeObject(JsonReader& reader, anime::Item& anime_item) {
+  if (!reader.BeginObject())
+    return false;
 
+  std::wstring name, value;
   std::vector<std::wstring> genres;
-  auto& genres_value = value["genres"];
-  for (size_t i = 0; i < genres_value.size(); i++)
-    genres.push_back(StrToWstr(genres_value[i]["name"].asString()));
+
+  while (reader.NextName(name)) {
+    if (name == L"slug") {
+      reader.ReadString(value);
+      anime_item.SetId(value, this->id());
+      anime_item.SetSlug(value);
+    } else if (name == L"status") {
+      reader.ReadString(value);
+      anime_item.SetAiringStatus(TranslateSeriesStatusFrom(value));
+    } else if (name == L"title") {
+      reader.ReadString(value);
+      anime_item.SetTitle(value);
+    } else if (name == L"alternate_title") {
+      reader.ReadString(value);
+      anime_item.SetSynonyms(value);
+    } else if (name == L"episode_count") {
+      int episode_count = 0;
+      reader.ReadInt(episode_count);
+      anime_item.SetEpisodeCount(episode_count);
+    } else if (name == L"cover_image") {
+      reader.ReadString(value);
+      anime_item.SetImageUrl(value);
+    } else if (name == L"synopsis") {
+      reader.ReadString(value);
+      anime_item.SetSynopsis(value);
+    } else if (name == L"show_type") {
+      reader.ReadString(value);
+      anime_item.SetType(TranslateSeriesTypeFrom(value));
+    } else if (name == L"genres") {
+      if (reader.BeginArray()) {
+        while (reader.NextElement()) {
+          if (!reader.BeginObject())
+            continue;
+          while (reader.NextName(name)) {
+            if (name == L"name") {
+              reader.ReadString(value);
+              genres.push_back(value);
+            } else {
+              reader.Skip();
+            }
+          }
+        }
+      }
+    } else {
+      reader.Skip();
+    }
+  }
 
   if (!genres.empty())
     anime_item.SetGenres(genres);
+
+  return !reader.error();
 }
 
 }  // namespace hummingbird
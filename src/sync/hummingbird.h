@@ -23,9 +23,7 @@
 #include "sync/hummingbird_types.h"
 #include "sync/service.h"
 
-namespace Json {
-class Value;
-}
+class JsonReader;
 
 namespace sync {
 namespace hummingbird {
@@ -53,7 +51,7 @@ private:
 
   bool RequestSucceeded(Response& response, const HttpResponse& http_response);
 
-  void ParseAnimeObject(Json::Value& value, anime::Item& anime_item);
+  bool ParseAnimeObject(JsonReader& reader, anime::Item& anime_item);
 
   string_t auth_token_;
 };
@@ -16,24 +16,36 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <unordered_map>
+
 #include "base/foreach.h"
+#include "base/logger.h"
 #include "base/string.h"
 #include "library/anime_db.h"
 #include "library/history.h"
+#include "sync/cache.h"
 #include "sync/hummingbird.h"
 #include "sync/manager.h"
 #include "sync/myanimelist.h"
 #include "sync/sync.h"
 #include "taiga/http.h"
 #include "taiga/settings.h"
+#include "taiga/stats.h"
 #include "taiga/taiga.h"
+#include "ui/dialog.h"
+#include "ui/dlg/dlg_main.h"
 #include "ui/ui.h"
 
 sync::Manager ServiceManager;
 
 namespace sync {
 
-Manager::Manager() {
+// Requests that fail because of a temporary problem on the server are made
+// again, up to this many times
+const unsigned int kMaxRetries = 3;
+
+Manager::Manager()
+    : pending_request_count_(0) {
   // Create services
   services_[kMyAnimeList].reset(new myanimelist::Service());
   services_[kHummingbird].reset(new hummingbird::Service());
@@ -43,6 +55,16 @@ Manager::~Manager() {
   // Services will automatically free themselves
 }
 
+bool Manager::busy() const {
+  return pending_request_count_ > 0;
+}
+
+void Manager::SetHostOverride(const std::wstring& host) {
+  win::Lock lock(queue_critical_section_);
+
+  host_override_ = host;
+}
+
 const Service* Manager::service(ServiceId service_id) {
   if (services_.count(service_id))
     return services_[service_id].get();
@@ -78,30 +100,205 @@ string_t Manager::GetServiceNameById(ServiceId service_id) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Identical requests of these types have identical results. Returns an empty
+// string for requests that must always be made.
+static std::wstring GetRequestKey(const Request& request) {
+  switch (request.type) {
+    case kGetMetadataById:
+    case kSearchTitle:
+    case kGetLibraryEntries:
+      break;
+    default:
+      return std::wstring();
+  }
+
+  std::wstring key = ToWstr(static_cast<int>(request.service_id)) + L"/" +
+                     ToWstr(static_cast<int>(request.type));
+  // Keys are logged, so authentication data is left out
+  foreach_c_(it, request.data) {
+    if (EndsWith(it->first, L"-username") ||
+        EndsWith(it->first, L"-password"))
+      continue;
+    key += L"/" + it->first + L"=" + it->second;
+  }
+
+  return key;
+}
+
+static void ConfigureRateLimiter(ServiceId service_id,
+                                 RateLimiter& rate_limiter) {
+  switch (service_id) {
+    case kMyAnimeList:
+      rate_limiter.Configure(
+          max(Settings.GetInt(taiga::kSync_Service_Mal_RequestRate), 0),
+          max(Settings.GetInt(taiga::kSync_Service_Mal_RequestBurst), 0));
+      break;
+    case kHummingbird:
+      rate_limiter.Configure(
+          max(Settings.GetInt(taiga::kSync_Service_Hummingbird_RequestRate), 0),
+          max(Settings.GetInt(taiga::kSync_Service_Hummingbird_RequestBurst), 0));
+      break;
+  }
+}
+
+Manager::QueuedRequest::QueuedRequest(const Request& request)
+    : request(request),
+      attempt(0) {
+}
+
 void Manager::MakeRequest(Request& request) {
-  foreach_(service, services_) {
-    if (request.service_id == kAllServices ||
-        request.service_id == service->first) {
-      // Create a new HTTP request, and store its UUID alongside the service
-      // request until we receive a response
-      HttpRequest http_request;
-      requests_.insert(std::make_pair(http_request.uuid, request));
-
-      // Make sure we store the actual service ID
-      if (request.service_id == kAllServices)
-        requests_[http_request.uuid].service_id = service->first;
-
-      // Let the service build the HTTP request
-      service->second->BuildRequest(request, http_request);
-
-      // Make the request
-      ConnectionManager.MakeRequest(http_request,
-                                    RequestTypeToClientMode(request.type));
+  std::vector<std::pair<Request, std::wstring>> cached_responses;
+
+  {
+    win::Lock lock(queue_critical_section_);
+
+    foreach_(service, services_) {
+      if (request.service_id == kAllServices ||
+          request.service_id == service->first) {
+        QueuedRequest queued_request(request);
+
+        // Make sure we store the actual service ID
+        queued_request.request.service_id = service->first;
+
+        // Stored responses are served right away. Stale ones are made again
+        // as well, so that they are replaced with the current data.
+        if (host_override_.empty()) {
+          std::wstring body;
+          CacheState cache_state = ResponseCache.Get(queued_request.request,
+                                                     body);
+          if (cache_state == kCacheFresh || cache_state == kCacheStale)
+            cached_responses.push_back(
+                std::make_pair(queued_request.request, body));
+          if (cache_state == kCacheFresh) {
+            LOG(LevelDebug, L"Cached response: " +
+                            GetCacheKey(queued_request.request));
+            continue;
+          }
+        }
+
+        // Identical requests that are already queued or in flight are not
+        // made again, as the response to the first one serves them all
+        std::wstring key = GetRequestKey(queued_request.request);
+        if (!key.empty()) {
+          if (active_requests_.count(key)) {
+            LOG(LevelDebug, L"Coalesced request: " + key);
+            continue;
+          }
+          active_requests_.insert(key);
+        }
+
+        queues_[service->first].push_back(queued_request);
+        InterlockedIncrement(&pending_request_count_);
+      }
     }
   }
+
+  foreach_(it, cached_responses)
+    HandleCachedResponse(it->first, it->second);
+
+  ProcessQueue();
+}
+
+void Manager::ProcessQueue() {
+  win::Lock lock(queue_critical_section_);
+
+  foreach_(it, queues_) {
+    auto& queue = it->second;
+    if (queue.empty())
+      continue;
+
+    RateLimiter& rate_limiter = rate_limiters_[it->first];
+    ConfigureRateLimiter(it->first, rate_limiter);
+
+    // Remaining requests are sent on a later call, which is made every second
+    // by the timer manager
+    while (!queue.empty() && rate_limiter.Acquire()) {
+      SendRequest(queue.front());
+      queue.pop_front();
+    }
+  }
+}
+
+void Manager::SendRequest(const QueuedRequest& queued_request) {
+  Request request = queued_request.request;
+
+  // Create a new HTTP request, and store its UUID alongside the service
+  // request until we receive a response
+  HttpRequest http_request;
+  requests_.insert(std::make_pair(http_request.uuid, request));
+  sent_requests_.insert(std::make_pair(http_request.uuid, queued_request));
+
+  // Let the service build the HTTP request
+  services_[request.service_id]->BuildRequest(request, http_request);
+
+  // Requests can be redirected to a server that stands in for the services
+  if (!host_override_.empty()) {
+    http_request.host = host_override_;
+    http_request.protocol = win::http::kHttp;
+  }
+
+  // Make the request
+  ConnectionManager.MakeRequest(http_request,
+                                RequestTypeToClientMode(request.type));
+}
+
+bool Manager::FinishRequest(const std::wstring& uuid) {
+  win::Lock lock(queue_critical_section_);
+
+  auto it = sent_requests_.find(uuid);
+  if (it == sent_requests_.end())
+    return false;
+
+  std::wstring key = GetRequestKey(it->second.request);
+  if (!key.empty())
+    active_requests_.erase(key);
+
+  sent_requests_.erase(it);
+  return true;
+}
+
+// Services respond with these codes when they are overloaded, or when we make
+// too many requests. Such requests are made again after a delay, and no other
+// requests are sent to the same service in the meantime.
+bool Manager::RetryRequest(const HttpResponse& http_response) {
+  if (http_response.code != 429 &&
+      (http_response.code < 500 || http_response.code > 599))
+    return false;
+
+  win::Lock lock(queue_critical_section_);
+
+  auto it = sent_requests_.find(http_response.uuid);
+  if (it == sent_requests_.end() || it->second.attempt >= kMaxRetries)
+    return false;
+
+  QueuedRequest queued_request = it->second;
+  sent_requests_.erase(it);
+
+  DWORD delay = GetBackoffDelay(queued_request.attempt++);
+  foreach_c_(header, http_response.header) {
+    if (IsEqual(header->first, L"Retry-After")) {
+      int seconds = ToInt(header->second);
+      if (seconds > 0)
+        delay = max(delay, static_cast<DWORD>(seconds) * 1000);
+      break;
+    }
+  }
+
+  LOG(LevelWarning, L"HTTP " + ToWstr(static_cast<int>(http_response.code)) +
+                    L", retrying in " + ToWstr(static_cast<ULONG>(delay)) +
+                    L" ms. ID: " + http_response.uuid);
+
+  ServiceId service_id = queued_request.request.service_id;
+  rate_limiters_[service_id].Pause(delay);
+  queues_[service_id].push_front(queued_request);
+
+  return true;
 }
 
 void Manager::HandleHttpError(HttpResponse& http_response, string_t error) {
+  bool finished = FinishRequest(http_response.uuid);
+  bool use_cache = IsCacheEnabled();
+
   win::Lock lock(critical_section_);
 
   const Request& request = requests_[http_response.uuid];
@@ -109,15 +306,35 @@ void Manager::HandleHttpError(HttpResponse& http_response, string_t error) {
   Response response;
   response.service_id = request.service_id;
   response.type = request.type;
-  response.data[L"error"] = error;
 
-  HandleError(response, http_response);
+  // Fall back to the stored response, however old it is
+  std::wstring body;
+  if (use_cache && ResponseCache.Get(request, body) != kCacheMiss) {
+    LOG(LevelWarning, L"Using cached response after error: " + error +
+                      L" ID: " + http_response.uuid);
+    http_response.code = 200;
+    http_response.body = body;
+    HandleResponse(response, http_response);
+  } else {
+    response.data[L"error"] = error;
+    HandleError(response, http_response);
+  }
 
   // FIXME: Not thread-safe. Invalidates iterators on other threads.
 //requests_.erase(http_response.uuid);
+
+  // Requests made by the handlers are counted by now
+  if (finished)
+    InterlockedDecrement(&pending_request_count_);
 }
 
 void Manager::HandleHttpResponse(HttpResponse& http_response) {
+  if (RetryRequest(http_response))
+    return;
+
+  bool finished = FinishRequest(http_response.uuid);
+  bool use_cache = IsCacheEnabled();
+
   win::Lock lock(critical_section_);
 
   const Request& request = requests_[http_response.uuid];
@@ -128,8 +345,132 @@ void Manager::HandleHttpResponse(HttpResponse& http_response) {
 
   HandleResponse(response, http_response);
 
+  if (use_cache && http_response.code == 200 &&
+      !response.data.count(L"error"))
+    ResponseCache.Set(request, http_response.body);
+
   // FIXME: Not thread-safe. Invalidates iterators on other threads.
 //requests_.erase(http_response.uuid);
+
+  if (finished)
+    InterlockedDecrement(&pending_request_count_);
+}
+
+void Manager::HandleCachedResponse(const Request& request,
+                                   const std::wstring& body) {
+  static volatile LONG counter = 0;
+
+  HttpResponse http_response;
+  http_response.code = 200;
+  http_response.body = body;
+  http_response.uuid = L"cache-" + PadChar(ToWstr(static_cast<ULONG>(
+      InterlockedIncrement(&counter))), L'0', 10);
+
+  win::Lock lock(critical_section_);
+
+  requests_.insert(std::make_pair(http_response.uuid, request));
+
+  Response response;
+  response.service_id = request.service_id;
+  response.type = request.type;
+
+  HandleResponse(response, http_response);
+}
+
+void Manager::HandleLibraryEntries() {
+  std::list<std::vector<anime::Item>> library_entries;
+  {
+    win::Lock lock(library_critical_section_);
+    library_entries.swap(library_entries_);
+  }
+
+  foreach_(entries, library_entries) {
+    // Stored items are looked up by the IDs of the service all at once, rather
+    // than by searching the database for each entry
+    std::unordered_map<std::wstring, anime::Item*> stored_items;
+    if (!entries->empty()) {
+      enum_t service_id = entries->front().GetSource();
+      foreach_(it, AnimeDatabase.items) {
+        const std::wstring& id = it->second.GetId(service_id);
+        if (!id.empty())
+          stored_items[id] = &it->second;
+      }
+    }
+
+    // Most entries are the same as the last time the list was downloaded, and
+    // only the ones that have changed are applied
+    int changed_count = 0;
+    int skipped_count = 0;
+    foreach_c_(anime_item, *entries) {
+      auto stored_item = stored_items.find(
+          anime_item->GetId(anime_item->GetSource()));
+      if (stored_item != stored_items.end() &&
+          !AnimeDatabase.HasChanges(*stored_item->second, *anime_item)) {
+        skipped_count++;
+        continue;
+      }
+      AnimeDatabase.UpdateItem(*anime_item);
+      changed_count++;
+    }
+
+    Stats.library_entries_changed += changed_count;
+    Stats.library_entries_skipped += skipped_count;
+    LOG(LevelDebug, L"Library entries changed: " + ToWstr(changed_count) +
+                    L", skipped: " + ToWstr(skipped_count));
+
+    if (changed_count > 0) {
+      AnimeDatabase.SaveList();
+      ui::ChangeStatusText(L"Successfully downloaded the list.");
+      ui::OnLibraryChange();
+    } else {
+      ui::ChangeStatusText(L"Successfully downloaded the list, no changes.");
+      ui::EnableDialogInput(ui::kDialogMain, true);
+    }
+
+    InterlockedDecrement(&pending_request_count_);
+  }
+}
+
+void Manager::HandleLibraryUpdates() {
+  std::vector<LibraryUpdate> library_updates;
+  {
+    win::Lock lock(library_critical_section_);
+    library_updates.swap(library_updates_);
+  }
+
+  foreach_(it, library_updates) {
+    if (it->success) {
+      ui::ClearStatusText();
+      History.queue.CompleteUpdate(it->anime_id);
+    } else {
+      History.queue.FailUpdate(it->anime_id);
+      ui::OnLibraryUpdateFailure(it->anime_id, it->error);
+    }
+
+    InterlockedDecrement(&pending_request_count_);
+  }
+}
+
+// The history queue is only modified on the UI thread, where items are added
+// to it, so results are passed on instead of being applied here.
+void Manager::AddLibraryUpdate(int anime_id, bool success,
+                               const string_t& error) {
+  {
+    win::Lock lock(library_critical_section_);
+    library_updates_.push_back(LibraryUpdate());
+    library_updates_.back().anime_id = anime_id;
+    library_updates_.back().success = success;
+    library_updates_.back().error = error;
+  }
+  InterlockedIncrement(&pending_request_count_);
+  ui::DlgMain.PostMessage(WM_TAIGA_LIBRARYUPDATED);
+}
+
+// Responses of the server that stands in for the services are not stored
+bool Manager::IsCacheEnabled() {
+  win::Lock lock(queue_critical_section_);
+
+  return host_override_.empty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -160,8 +501,7 @@ void Manager::HandleError(Response& response, HttpResponse& http_response) {
     case kAddLibraryEntry:
     case kDeleteLibraryEntry:
     case kUpdateLibraryEntry:
-      History.queue.updating = false;
-      ui::OnLibraryUpdateFailure(anime_id, response.data[L"error"]);
+      AddLibraryUpdate(anime_id, false, response.data[L"error"]);
       break;
     default:
       ui::ChangeStatusText(response.data[L"error"]);
@@ -218,22 +558,22 @@ void Manager::HandleResponse(Response& response, HttpResponse& http_response) {
     }
 
     case kGetLibraryEntries: {
-      AnimeDatabase.SaveList();
-      ui::ChangeStatusText(L"Successfully downloaded the list.");
-      ui::OnLibraryChange();
+      // Entries are added to the database on the UI thread, where it is read.
+      // Until then, the request is not considered to be completed.
+      {
+        win::Lock lock(library_critical_section_);
+        library_entries_.push_back(std::vector<anime::Item>());
+        library_entries_.back().swap(response.items);
+      }
+      InterlockedIncrement(&pending_request_count_);
+      ui::DlgMain.PostMessage(WM_TAIGA_LIBRARYPARSED);
       break;
     }
 
     case kAddLibraryEntry:
     case kDeleteLibraryEntry:
     case kUpdateLibraryEntry: {
-      History.queue.updating = false;
-      ui::ClearStatusText();
-
-      auto history_item = History.queue.GetCurrentItem();
-      if (history_item)
-        AnimeDatabase.UpdateItem(*history_item);
-
+      AddLibraryUpdate(anime_id, true, string_t());
       break;
     }
   }
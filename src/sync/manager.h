@@ -19,9 +19,15 @@
 #ifndef TAIGA_SYNC_MANAGER_H
 #define TAIGA_SYNC_MANAGER_H
 
+#include <deque>
+#include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
+#include "rate_limiter.h"
 #include "service.h"
 #include "base/types.h"
 #include "taiga/http.h"
@@ -38,9 +44,22 @@ public:
   ~Manager();
 
   void MakeRequest(Request& request);
+  void ProcessQueue();
+  void SetHostOverride(const std::wstring& host);
   void HandleHttpError(HttpResponse& http_response, string_t error);
   void HandleHttpResponse(HttpResponse& http_response);
 
+  // Adds the entries of downloaded lists to the database, must be called on
+  // the UI thread
+  void HandleLibraryEntries();
+  // Applies the results of library updates to the history queue, must be
+  // called on the UI thread
+  void HandleLibraryUpdates();
+
+  // Returns true until all requests, and the requests made by their handlers,
+  // are completed
+  bool busy() const;
+
   const Service* service(ServiceId service_id);
   const Service* service(const string_t& canonical_name);
 
@@ -48,12 +67,53 @@ public:
   string_t GetServiceNameById(ServiceId service_id);
 
 private:
+  class QueuedRequest {
+  public:
+    QueuedRequest(const Request& request);
+
+    Request request;
+    unsigned int attempt;
+  };
+
+  class LibraryUpdate {
+  public:
+    int anime_id;
+    bool success;
+    string_t error;
+  };
+
+  void AddLibraryUpdate(int anime_id, bool success, const string_t& error);
+
   void HandleError(Response& response, HttpResponse& http_response);
   void HandleResponse(Response& response, HttpResponse& http_response);
 
+  void HandleCachedResponse(const Request& request, const std::wstring& body);
+  bool IsCacheEnabled();
+
+  bool FinishRequest(const std::wstring& uuid);
+  bool RetryRequest(const HttpResponse& http_response);
+  void SendRequest(const QueuedRequest& queued_request);
+
   win::CriticalSection critical_section_;
   std::map<std::wstring, Request> requests_;
   std::map<ServiceId, std::unique_ptr<Service>> services_;
+
+  // Requests wait in these queues until their services' rate limiters allow
+  // them to be sent. The queue has its own lock, as response handlers are
+  // allowed to make new requests.
+  win::CriticalSection queue_critical_section_;
+  std::set<std::wstring> active_requests_;
+  std::map<ServiceId, std::deque<QueuedRequest>> queues_;
+  std::map<ServiceId, RateLimiter> rate_limiters_;
+  std::map<std::wstring, QueuedRequest> sent_requests_;
+  std::wstring host_override_;
+  volatile LONG pending_request_count_;
+
+  // Entries of downloaded lists and results of library updates, waiting to be
+  // applied on the UI thread
+  win::CriticalSection library_critical_section_;
+  std::list<std::vector<anime::Item>> library_entries_;
+  std::vector<LibraryUpdate> library_updates_;
 };
 
 }  // namespace sync
@@ -206,9 +206,80 @@ void Service::AuthenticateUser(Response& response, HttpResponse& http_response)
       InStr(http_response.body, L"<username>", L"</username>");
 }
 
+// Tags of the anime nodes in user lists, sorted by name so that they can be
+// looked up with a binary search
+enum LibraryEntryTag {
+  kTagUnknown,
+  kTagMyFinishDate,
+  kTagMyLastUpdated,
+  kTagMyRewatching,
+  kTagMyRewatchingEp,
+  kTagMyScore,
+  kTagMyStartDate,
+  kTagMyStatus,
+  kTagMyTags,
+  kTagMyWatchedEpisodes,
+  kTagSeriesAnimedbId,
+  kTagSeriesEnd,
+  kTagSeriesEpisodes,
+  kTagSeriesImage,
+  kTagSeriesStart,
+  kTagSeriesStatus,
+  kTagSeriesSynonyms,
+  kTagSeriesTitle,
+  kTagSeriesType
+};
+
+const struct {
+  const wchar_t* name;
+  LibraryEntryTag tag;
+} kLibraryEntryTags[] = {
+  {L"my_finish_date", kTagMyFinishDate},
+  {L"my_last_updated", kTagMyLastUpdated},
+  {L"my_rewatching", kTagMyRewatching},
+  {L"my_rewatching_ep", kTagMyRewatchingEp},
+  {L"my_score", kTagMyScore},
+  {L"my_start_date", kTagMyStartDate},
+  {L"my_status", kTagMyStatus},
+  {L"my_tags", kTagMyTags},
+  {L"my_watched_episodes", kTagMyWatchedEpisodes},
+  {L"series_animedb_id", kTagSeriesAnimedbId},
+  {L"series_end", kTagSeriesEnd},
+  {L"series_episodes", kTagSeriesEpisodes},
+  {L"series_image", kTagSeriesImage},
+  {L"series_start", kTagSeriesStart},
+  {L"series_status", kTagSeriesStatus},
+  {L"series_synonyms", kTagSeriesSynonyms},
+  {L"series_title", kTagSeriesTitle},
+  {L"series_type", kTagSeriesType},
+};
+
+static LibraryEntryTag FindLibraryEntryTag(const wchar_t* name) {
+  size_t first = 0;
+  size_t last = sizeof(kLibraryEntryTags) / sizeof(*kLibraryEntryTags);
+
+  while (first < last) {
+    size_t middle = first + (last - first) / 2;
+    int result = wcscmp(name, kLibraryEntryTags[middle].name);
+    if (result == 0)
+      return kLibraryEntryTags[middle].tag;
+    if (result < 0) {
+      last = middle;
+    } else {
+      first = middle + 1;
+    }
+  }
+
+  return kTagUnknown;
+}
+
 void Service::GetLibraryEntries(Response& response, HttpResponse& http_response) {
+  // Lists of large accounts are several megabytes long, so the body is parsed
+  // in place rather than copied. It is not usable afterwards.
   xml_document document;
-  xml_parse_result parse_result = document.load(http_response.body.c_str());
+  xml_parse_result parse_result = document.load_buffer_inplace(
+      &http_response.body[0], http_response.body.size() * sizeof(wchar_t),
+      pugi::parse_default, pugi::encoding_wchar);
 
   if (parse_result.status != pugi::status_ok) {
     response.data[L"error"] = L"Could not parse the list";
@@ -232,53 +303,79 @@ void Service::GetLibraryEntries(Response& response, HttpResponse& http_response)
   // We ignore the remaining tags, because MAL can be very slow at updating
   // their values, and we can easily calculate them ourselves anyway.
 
-  // Available tags:
-  // - series_animedb_id
-  // - series_title
-  // - series_synonyms (separated by "; ")
-  // - series_type
-  // - series_episodes
-  // - series_status
-  // - series_start
-  // - series_end
-  // - series_image
-  // - my_id (deprecated)
-  // - my_watched_episodes
-  // - my_start_date
-  // - my_finish_date
-  // - my_score
-  // - my_status
-  // - my_rewatching
-  // - my_rewatching_ep
-  // - my_last_updated
-  // - my_tags
+  // Available tags are listed in kLibraryEntryTags, except for my_id, which is
+  // deprecated. Each node is visited once, instead of looking up every tag by
+  // name. Entries are added to the database later, on the UI thread.
+  time_t current_time = time(nullptr);
+
   foreach_xmlnode_(node, node_myanimelist, L"anime") {
     ::anime::Item anime_item;
     anime_item.SetSource(this->id());
-    anime_item.SetId(XmlReadStrValue(node, L"series_animedb_id"), this->id());
-    anime_item.SetLastModified(time(nullptr));  // current time
+    anime_item.SetLastModified(current_time);
+    anime_item.AddtoUserList();
 
-    anime_item.SetTitle(XmlReadStrValue(node, L"series_title"));
-    anime_item.SetSynonyms(XmlReadStrValue(node, L"series_synonyms"));
-    anime_item.SetType(TranslateSeriesTypeFrom(XmlReadIntValue(node, L"series_type")));
-    anime_item.SetEpisodeCount(XmlReadIntValue(node, L"series_episodes"));
-    anime_item.SetAiringStatus(TranslateSeriesStatusFrom(XmlReadIntValue(node, L"series_status")));
-    anime_item.SetDateStart(XmlReadStrValue(node, L"series_start"));
-    anime_item.SetDateEnd(XmlReadStrValue(node, L"series_end"));
-    anime_item.SetImageUrl(XmlReadStrValue(node, L"series_image"));
+    for (xml_node child = node.first_child(); child;
+         child = child.next_sibling()) {
+      const wchar_t* value = child.child_value();
+      switch (FindLibraryEntryTag(child.name())) {
+        case kTagSeriesAnimedbId:
+          anime_item.SetId(value, this->id());
+          break;
+        case kTagSeriesTitle:
+          anime_item.SetTitle(value);
+          break;
+        case kTagSeriesSynonyms:
+          anime_item.SetSynonyms(value);
+          break;
+        case kTagSeriesType:
+          anime_item.SetType(TranslateSeriesTypeFrom(_wtoi(value)));
+          break;
+        case kTagSeriesEpisodes:
+          anime_item.SetEpisodeCount(_wtoi(value));
+          break;
+        case kTagSeriesStatus:
+          anime_item.SetAiringStatus(TranslateSeriesStatusFrom(_wtoi(value)));
+          break;
+        case kTagSeriesStart:
+          anime_item.SetDateStart(Date(value));
+          break;
+        case kTagSeriesEnd:
+          anime_item.SetDateEnd(Date(value));
+          break;
+        case kTagSeriesImage:
+          anime_item.SetImageUrl(value);
+          break;
+        case kTagMyWatchedEpisodes:
+          anime_item.SetMyLastWatchedEpisode(_wtoi(value));
+          break;
+        case kTagMyStartDate:
+          anime_item.SetMyDateStart(Date(value));
+          break;
+        case kTagMyFinishDate:
+          anime_item.SetMyDateEnd(Date(value));
+          break;
+        case kTagMyScore:
+          anime_item.SetMyScore(_wtoi(value));
+          break;
+        case kTagMyStatus:
+          anime_item.SetMyStatus(TranslateMyStatusFrom(_wtoi(value)));
+          break;
+        case kTagMyRewatching:
+          anime_item.SetMyRewatching(_wtoi(value));
+          break;
+        case kTagMyRewatchingEp:
+          anime_item.SetMyRewatchingEp(_wtoi(value));
+          break;
+        case kTagMyLastUpdated:
+          anime_item.SetMyLastUpdated(value);
+          break;
+        case kTagMyTags:
+          anime_item.SetMyTags(value);
+          break;
+      }
+    }
 
-    anime_item.AddtoUserList();
-    anime_item.SetMyLastWatchedEpisode(XmlReadIntValue(node, L"my_watched_episodes"));
-    anime_item.SetMyDateStart(XmlReadStrValue(node, L"my_start_date"));
-    anime_item.SetMyDateEnd(XmlReadStrValue(node, L"my_finish_date"));
-    anime_item.SetMyScore(XmlReadIntValue(node, L"my_score"));
-    anime_item.SetMyStatus(TranslateMyStatusFrom(XmlReadIntValue(node, L"my_status")));
-    anime_item.SetMyRewatching(XmlReadIntValue(node, L"my_rewatching"));
-    anime_item.SetMyRewatchingEp(XmlReadIntValue(node, L"my_rewatching_ep"));
-    anime_item.SetMyLastUpdated(XmlReadStrValue(node, L"my_last_updated"));
-    anime_item.SetMyTags(XmlReadStrValue(node, L"my_tags"));
-
-    AnimeDatabase.UpdateItem(anime_item);
+    response.items.push_back(anime_item);
   }
 }
 
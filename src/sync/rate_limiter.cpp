@@ -0,0 +1,111 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "rate_limiter.h"
+
+namespace sync {
+
+const DWORD kBackoffInitialDelay = 1000;  // 1 second
+const DWORD kBackoffMaxDelay = 60000;     // 1 minute
+
+RateLimiter::RateLimiter()
+    : burst_(0),
+      rate_(0),
+      tokens_(0.0),
+      last_refill_time_(::GetTickCount()),
+      pause_time_(0),
+      pause_length_(0) {
+}
+
+bool RateLimiter::Acquire() {
+  DWORD now = ::GetTickCount();
+
+  if (pause_length_ > 0) {
+    if (now - pause_time_ < pause_length_)
+      return false;
+    pause_length_ = 0;
+    last_refill_time_ = now;
+  }
+
+  // A rate of zero means that requests are not limited
+  if (rate_ == 0)
+    return true;
+
+  Refill(now);
+
+  if (tokens_ < 1.0)
+    return false;
+
+  tokens_ -= 1.0;
+  return true;
+}
+
+void RateLimiter::Configure(unsigned int rate, unsigned int burst) {
+  burst = max(burst, 1);
+  if (rate == rate_ && burst == burst_)
+    return;
+
+  rate_ = rate;
+  burst_ = burst;
+
+  tokens_ = burst_;
+  last_refill_time_ = ::GetTickCount();
+}
+
+void RateLimiter::Pause(DWORD milliseconds) {
+  DWORD now = ::GetTickCount();
+
+  // Pauses can only be extended
+  if (pause_length_ > 0) {
+    DWORD remaining = pause_length_ - min(now - pause_time_, pause_length_);
+    if (remaining >= milliseconds)
+      return;
+  }
+
+  pause_time_ = now;
+  pause_length_ = milliseconds;
+
+  // Requests are sent one at a time after a pause, to avoid hitting the
+  // service with a burst right after it told us to slow down
+  tokens_ = min(tokens_, 1.0);
+}
+
+void RateLimiter::Refill(DWORD now) {
+  DWORD elapsed = now - last_refill_time_;
+  last_refill_time_ = now;
+
+  tokens_ += elapsed * rate_ / 1000.0;
+  if (tokens_ > burst_)
+    tokens_ = burst_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DWORD GetBackoffDelay(unsigned int attempt) {
+  DWORD delay = kBackoffInitialDelay << min(attempt, 16);
+  delay = min(delay, kBackoffMaxDelay);
+
+  // Half of the delay is fixed, the other half is random
+  DWORD jitter = static_cast<DWORD>(rand()) % (delay / 2 + 1);
+
+  return delay / 2 + jitter;
+}
+
+}  // namespace sync
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_SYNC_RATE_LIMITER_H
+#define TAIGA_SYNC_RATE_LIMITER_H
+
+#include <windows.h>
+
+namespace sync {
+
+// A token bucket that limits the rate of requests that are sent to a service.
+// Requests can be sent in bursts, as long as the bucket has tokens left. The
+// limiter can also be paused, when the service asks us to slow down.
+
+class RateLimiter {
+public:
+  RateLimiter();
+  ~RateLimiter() {}
+
+  // Takes a token, if a request can be sent now
+  bool Acquire();
+  void Configure(unsigned int rate, unsigned int burst);
+  void Pause(DWORD milliseconds);
+
+private:
+  void Refill(DWORD now);
+
+  unsigned int burst_;
+  unsigned int rate_;  // requests per second
+  double tokens_;
+  DWORD last_refill_time_;
+  DWORD pause_time_;
+  DWORD pause_length_;
+};
+
+// Returns an exponentially increasing delay for the given attempt, with random
+// jitter so that retries from different requests are spread out.
+DWORD GetBackoffDelay(unsigned int attempt);
+
+}  // namespace sync
+
+#endif  // TAIGA_SYNC_RATE_LIMITER_H
\ No newline at end of file
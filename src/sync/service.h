@@ -19,7 +19,10 @@
 #ifndef TAIGA_SYNC_SERVICE_H
 #define TAIGA_SYNC_SERVICE_H
 
+#include <vector>
+
 #include "base/types.h"
+#include "library/anime_item.h"
 
 // A service, in Taiga's terms, is a web application that provides an API that
 // is based on HTTP requests and responses. Services are used for metadata
@@ -67,6 +70,7 @@ public:
   ServiceId service_id;
   RequestType type;
   dictionary_t data;
+  std::vector<anime::Item> items;
 };
 
 class User {
@@ -17,11 +17,13 @@
 */
 
 #include "base/encryption.h"
+#include "base/file.h"
 #include "base/foreach.h"
 #include "base/string.h"
 #include "library/anime_db.h"
 #include "library/anime_util.h"
 #include "library/history.h"
+#include "library/resource.h"
 #include "sync/manager.h"
 #include "sync/sync.h"
 #include "taiga/http.h"
@@ -49,6 +51,11 @@ void GetLibraryEntries() {
 }
 
 void GetMetadataById(int id) {
+  // There's nothing to gain from a request if we've recently received the data
+  auto anime_item = AnimeDatabase.FindItem(id);
+  if (anime_item && !anime::MetadataNeedsRefresh(*anime_item))
+    return;
+
   Request request(kGetMetadataById);
   SetActiveServiceForRequest(request);
   if (!AddAuthenticationToRequest(request))
@@ -103,14 +110,14 @@ void Synchronize() {
   }
 }
 
-void UpdateLibraryEntry(AnimeValues& anime_values, int id,
+bool UpdateLibraryEntry(AnimeValues& anime_values, int id,
                         taiga::HttpClientMode http_client_mode) {
   RequestType request_type = ClientModeToRequestType(http_client_mode);
 
   Request request(request_type);
   SetActiveServiceForRequest(request);
   if (!AddAuthenticationToRequest(request))
-    return;
+    return false;
   AddServiceDataToRequest(request, id);
 
   if (anime_values.episode)
@@ -129,6 +136,7 @@ void UpdateLibraryEntry(AnimeValues& anime_values, int id,
     request.data[L"tags"] = *anime_values.tags;
 
   ServiceManager.MakeRequest(request);
+  return true;
 }
 
 void DownloadImage(int id, const string_t& image_url) {
@@ -142,8 +150,20 @@ void DownloadImage(int id, const string_t& image_url) {
   http_request.path = url.path;
   http_request.parameter = id;
 
+  // Make a conditional request, so that the server can tell us if the image
+  // has not changed since the last time we downloaded it
+  std::wstring path = ::anime::GetImagePath(id);
+  ::anime::ImageIndexItem index_item;
+  if (ImageDatabase.index.Get(id, index_item) && FileExists(path)) {
+    if (!index_item.etag.empty())
+      http_request.header[L"If-None-Match"] = index_item.etag;
+    if (!index_item.last_modified.empty())
+      http_request.header[L"If-Modified-Since"] = index_item.last_modified;
+  }
+
+  // The file is moved into place after the response is checked
   auto& client = ConnectionManager.GetNewClient(http_request.uuid);
-  client.set_download_path(::anime::GetImagePath(id));
+  client.set_download_path(path + L".part");
   ConnectionManager.MakeRequest(client, http_request,
                                 taiga::kHttpGetLibraryEntryImage);
 }
@@ -31,7 +31,7 @@ void GetLibraryEntries();
 void GetMetadataById(int id);
 void SearchTitle(string_t title, int id);
 void Synchronize();
-void UpdateLibraryEntry(AnimeValues& anime_values, int id,
+bool UpdateLibraryEntry(AnimeValues& anime_values, int id,
                         taiga::HttpClientMode http_client_mode);
 
 void DownloadImage(int id, const std::wstring& image_url);
@@ -16,11 +16,27 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "base/file.h"
+#include "base/foreach.h"
+#include "base/json.h"
 #include "base/string.h"
+#include "base/xml.h"
 #include "library/anime_db.h"
+#include "library/history.h"
+#include "sync/hummingbird.h"
+#include "sync/hummingbird_util.h"
+#include "sync/manager.h"
+#include "sync/sync.h"
 #include "taiga/debug.h"
+#include "taiga/debug_server.h"
+#include "taiga/path.h"
+#include "taiga/settings.h"
+#include "taiga/stats.h"
+#include "taiga/taiga.h"
+#include "track/feed.h"
 #include "ui/dlg/dlg_main.h"
 #include "ui/dialog.h"
+#include "ui/ui.h"
 
 namespace debug {
 
@@ -40,7 +56,7 @@ void Tester::Start() {
   value_ = li.QuadPart;
 }
 
-void Tester::End(std::wstring str, bool display_result) {
+double Tester::End(std::wstring str, bool display_result) {
   LARGE_INTEGER li;
 
   ::QueryPerformanceCounter(&li);
@@ -50,6 +66,8 @@ void Tester::End(std::wstring str, bool display_result) {
     str = ToWstr(value, 2) + L"ms | Text: [" + str + L"]";
     ui::DlgMain.SetText(str);
   }
+
+  return value;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -63,6 +81,33 @@ void Print(std::wstring text) {
 }
 
 void Test() {
+  // Hold Shift to benchmark the feed pipeline instead
+  if (::GetKeyState(VK_SHIFT) & 0x8000) {
+    std::wstring path = taiga::GetPath(taiga::kPathFeed) + L"benchmark.json";
+    if (BenchmarkFeeds(path))
+      ui::DlgMain.SetText(L"Benchmark results saved to " + path);
+    return;
+  }
+
+  // Hold Control to benchmark synchronization
+  if (::GetKeyState(VK_CONTROL) & 0x8000) {
+    std::wstring path = taiga::GetPath(taiga::kPathUser) + L"benchmark.json";
+    if (BenchmarkSync(path)) {
+      ui::DlgMain.SetText(L"Benchmark results saved to " + path);
+    } else {
+      ui::DlgMain.SetText(L"Could not run the benchmark");
+    }
+    return;
+  }
+
+  // Hold Alt to benchmark parsing Hummingbird lists
+  if (::GetKeyState(VK_MENU) & 0x8000) {
+    std::wstring path = taiga::GetPath(taiga::kPathUser) + L"benchmark_json.json";
+    if (BenchmarkJson(path))
+      ui::DlgMain.SetText(L"Benchmark results saved to " + path);
+    return;
+  }
+
   // Define variables
   std::wstring str;
 
@@ -86,4 +131,406 @@ void Test() {
   test.End(str, 0);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+class StringWriter : public pugi::xml_writer {
+public:
+  void write(const void* data, size_t size) {
+    output.append(static_cast<const char*>(data), size);
+  }
+
+  std::string output;
+};
+
+static unsigned int GetRandomNumber(unsigned int& seed) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7FFF;
+}
+
+// Generates a feed with release-style titles. Titles of the anime in the
+// database are used when available, so that items can be matched. Episode
+// numbers are limited to what has already aired, so that benchmarking
+// doesn't affect the last aired episode numbers of the anime.
+static std::string GenerateFeed(size_t item_count) {
+  static const wchar_t* groups[] = {
+      L"Commie", L"FFF", L"gg", L"HorribleSubs", L"Underwater", L"UTW",
+      L"Vivid", L"WhyNot"};
+  static const wchar_t* resolutions[] = {
+      L"480p", L"720p", L"1080p", L"1280x720", L"1920x1080"};
+  static const wchar_t* extras[] = {
+      L"", L"v2", L" (BD)", L" (x264 AAC)", L" [10-bit]"};
+
+  std::vector<std::pair<std::wstring, int>> titles;
+  foreach_(it, AnimeDatabase.items) {
+    int episode_count = it->second.GetLastAiredEpisodeNumber(true);
+    if (episode_count > 0)
+      titles.push_back(std::make_pair(it->second.GetTitle(), episode_count));
+    if (titles.size() >= 500)
+      break;
+  }
+  if (titles.empty())
+    for (int i = 1; i <= 100; i++)
+      titles.push_back(std::make_pair(L"Series " + ToWstr(i), 26));
+
+  unsigned int seed = 1;
+
+  xml_document document;
+  xml_node rss_node = document.append_child(L"rss");
+  rss_node.append_attribute(L"version") = L"2.0";
+  xml_node channel = rss_node.append_child(L"channel");
+  XmlWriteStrValue(channel, L"title", L"Taiga Benchmark");
+  XmlWriteStrValue(channel, L"link", L"http://localhost/");
+  XmlWriteStrValue(channel, L"description", L"Synthetic feed");
+
+  for (size_t i = 0; i < item_count; i++) {
+    const auto& title = titles.at(GetRandomNumber(seed) % titles.size());
+    int episode = GetRandomNumber(seed) % title.second + 1;
+    std::wstring group = groups[GetRandomNumber(seed) % 8];
+    std::wstring resolution = resolutions[GetRandomNumber(seed) % 5];
+    std::wstring extra = extras[GetRandomNumber(seed) % 5];
+
+    std::wstring item_title = L"[" + group + L"] " + title.first + L" - " +
+                              PadChar(ToWstr(episode), '0', 2) + extra +
+                              L" [" + resolution + L"].mkv";
+    std::wstring link = L"http://localhost/torrent/" + ToWstr(static_cast<int>(i));
+    std::wstring description = L"Size: " +
+        ToWstr(static_cast<int>(GetRandomNumber(seed) % 1500 + 100)) + L" MiB";
+
+    xml_node item = channel.append_child(L"item");
+    XmlWriteStrValue(item, L"title", item_title.c_str());
+    XmlWriteStrValue(item, L"link", link.c_str());
+    XmlWriteStrValue(item, L"guid", link.c_str());
+    XmlWriteStrValue(item, L"category", L"Anime");
+    XmlWriteStrValue(item, L"description", description.c_str());
+  }
+
+  StringWriter writer;
+  document.save(writer, L"", pugi::format_raw, pugi::encoding_utf8);
+
+  return writer.output;
+}
+
+bool BenchmarkFeeds(const std::wstring& path, size_t item_count,
+                    size_t iterations, bool user_filters) {
+  enum Stage {
+    kStageLoad,
+    kStageExamine,
+    kStageExamineCached,
+    kStageMarkNewEpisodes,
+    kStageFilter,
+    kStageFilterPreferences,
+    kStageFilterArchived,
+    kStageCount
+  };
+  static const char* stage_names[] = {
+      "load", "examine", "examine_cached", "mark_new_episodes", "filter",
+      "filter_preferences", "filter_archived"};
+
+  std::string data = GenerateFeed(item_count);
+
+  // Default presets are used, along with the filters of the user if needed
+  FeedFilterManager filter_manager;
+  filter_manager.AddPresets();
+  if (user_filters)
+    foreach_(it, Aggregator.filter_manager.filters)
+      filter_manager.filters.push_back(*it);
+
+  double totals[kStageCount] = {0};
+  size_t feed_item_count = 0;
+  Tester tester;
+
+  #define BENCHMARK_STAGE(stage, x) \
+      tester.Start(); \
+      x; \
+      totals[stage] += tester.End(L"", false);
+
+  for (size_t i = 0; i < iterations; i++) {
+    Feed feed;
+    feed.link = L"http://localhost/";
+
+    BENCHMARK_STAGE(kStageLoad, feed.Load(data));
+    BENCHMARK_STAGE(kStageExamine, feed.Examine());
+    BENCHMARK_STAGE(kStageExamineCached, feed.Examine());
+    BENCHMARK_STAGE(kStageMarkNewEpisodes, filter_manager.MarkNewEpisodes(feed));
+    BENCHMARK_STAGE(kStageFilter, filter_manager.Filter(feed, false));
+    BENCHMARK_STAGE(kStageFilterPreferences, filter_manager.Filter(feed, true));
+    BENCHMARK_STAGE(kStageFilterArchived, filter_manager.FilterArchived(feed));
+
+    feed_item_count = feed.items.size();
+  }
+
+  #undef BENCHMARK_STAGE
+
+  Json::Value root;
+  root["items"] = static_cast<Json::UInt>(feed_item_count);
+  root["iterations"] = static_cast<Json::UInt>(iterations);
+  root["feed_size"] = static_cast<Json::UInt>(data.size());
+  root["filters"] = static_cast<Json::UInt>(filter_manager.filters.size());
+  root["filters_enabled"] = Settings.GetBool(taiga::kTorrent_Filter_Enabled);
+
+  Json::Value& stages = root["stages"];
+  for (int i = 0; i < kStageCount; i++) {
+    double average = iterations ? totals[i] / iterations : 0.0;
+    Json::Value stage;
+    stage["name"] = stage_names[i];
+    stage["total_ms"] = totals[i];
+    stage["average_ms"] = average;
+    stage["items_per_second"] =
+        average > 0.0 ? feed_item_count / (average / 1000.0) : 0.0;
+    stages.append(stage);
+  }
+
+  Json::StyledWriter writer;
+  std::string output = writer.write(root);
+
+  return SaveToFile((LPCVOID)output.data(), output.size(), path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Dispatches messages while waiting, as response handlers send messages to the
+// UI thread, and the timer manager processes the request queue.
+static bool WaitForSynchronization(DWORD timeout) {
+  DWORD start_time = ::GetTickCount();
+
+  while (ServiceManager.busy()) {
+    if (::GetTickCount() - start_time > timeout)
+      return false;
+    ::MsgWaitForMultipleObjects(0, nullptr, FALSE, 10, QS_ALLINPUT);
+    MSG msg;
+    while (::PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+      ::TranslateMessage(&msg);
+      ::DispatchMessage(&msg);
+    }
+  }
+
+  return true;
+}
+
+bool BenchmarkSync(const std::wstring& path, size_t list_size, size_t cycles,
+                   unsigned int latency, unsigned int error_rate) {
+  // Queued items would be sent to the stand-in server, and lost
+  if (History.queue.GetItemCount() > 0 || ServiceManager.busy())
+    return false;
+  if (taiga::GetCurrentUsername().empty())
+    return false;
+
+  std::set<int> existing_ids;
+  foreach_(it, AnimeDatabase.items)
+    existing_ids.insert(it->first);
+
+  ApiServer server;
+  server.options.error_rate = error_rate;
+  server.options.latency = latency;
+  server.options.list_size = list_size;
+  server.options.username = WstrToStr(taiga::GetCurrentUsername());
+  if (!server.Start())
+    return false;
+
+  ServiceManager.SetHostOverride(server.host());
+  bool logged_in = Taiga.logged_in;
+  int entries_changed = Stats.library_entries_changed;
+  int entries_skipped = Stats.library_entries_skipped;
+
+  std::vector<double> timings;
+  size_t completed_cycles = 0;
+  Tester tester;
+
+  // Each cycle logs in and downloads the list, as it would on startup
+  for (size_t i = 0; i < cycles; i++) {
+    Taiga.logged_in = false;
+    tester.Start();
+    sync::Synchronize();
+    bool completed = WaitForSynchronization(60 * 1000);
+    timings.push_back(tester.End(L"", false));
+    if (!completed)
+      break;
+    completed_cycles++;
+  }
+
+  ServiceManager.SetHostOverride(L"");
+  server.Stop();
+  Taiga.logged_in = logged_in;
+
+  // Remove the entries that were added by the stand-in server
+  for (auto it = AnimeDatabase.items.begin();
+       it != AnimeDatabase.items.end(); ) {
+    if (!existing_ids.count(it->first)) {
+      AnimeDatabase.items.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  AnimeDatabase.SaveList();
+  ui::OnLibraryChange();
+
+  Json::Value root;
+  root["service"] = WstrToStr(taiga::GetCurrentService()->canonical_name());
+  root["list_size"] = static_cast<Json::UInt>(list_size);
+  root["latency_ms"] = latency;
+  root["error_rate"] = error_rate;
+  root["cycles"] = static_cast<Json::UInt>(cycles);
+  root["completed_cycles"] = static_cast<Json::UInt>(completed_cycles);
+
+  double total = 0.0;
+  Json::Value& timings_value = root["cycle_ms"];
+  foreach_(it, timings) {
+    timings_value.append(*it);
+    total += *it;
+  }
+  root["average_ms"] = timings.empty() ? 0.0 : total / timings.size();
+
+  static const char* request_names[] = {
+      "generic", "authenticate_user", "get_metadata_by_id", "search_title",
+      "add_library_entry", "delete_library_entry", "get_library_entries",
+      "update_library_entry"};
+  Json::Value& requests = root["requests"];
+  Json::UInt request_count = 0;
+  for (int i = 0; i <= sync::kUpdateLibraryEntry; i++) {
+    requests[request_names[i]] =
+        static_cast<Json::UInt>(server.statistics.requests[i]);
+    request_count += server.statistics.requests[i];
+  }
+  root["request_count"] = request_count;
+  root["errors_injected"] = static_cast<Json::UInt>(server.statistics.errors);
+  root["bytes_received"] =
+      static_cast<Json::UInt>(server.statistics.bytes_received);
+  root["bytes_sent"] = static_cast<Json::UInt>(server.statistics.bytes_sent);
+  root["entries_changed"] = Stats.library_entries_changed - entries_changed;
+  root["entries_skipped"] = Stats.library_entries_skipped - entries_skipped;
+
+  Json::StyledWriter writer;
+  std::string output = writer.write(root);
+
+  return SaveToFile((LPCVOID)output.data(), output.size(), path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Hummingbird lists used to be parsed into a tree of values, which were then
+// copied into anime items. This is kept here for comparison.
+static void ParseHummingbirdLibrary(const std::wstring& body,
+                                    std::vector<anime::Item>& anime_items) {
+  using namespace sync::hummingbird;
+
+  Json::Value root;
+  Json::Reader reader;
+  if (!reader.parse(WstrToStr(body), root))
+    return;
+
+  for (size_t i = 0; i < root.size(); i++) {
+    auto& value = root[i];
+    auto& anime_value = value["anime"];
+    auto& rating_value = value["rating"];
+
+    anime::Item anime_item;
+    anime_item.SetSource(sync::kHummingbird);
+    anime_item.SetId(StrToWstr(anime_value["slug"].asString()), sync::kHummingbird);
+    anime_item.SetLastModified(time(nullptr));
+
+    anime_item.SetSlug(StrToWstr(anime_value["slug"].asString()));
+    anime_item.SetAiringStatus(TranslateSeriesStatusFrom(StrToWstr(anime_value["status"].asString())));
+    anime_item.SetTitle(StrToWstr(anime_value["title"].asString()));
+    anime_item.SetSynonyms(StrToWstr(anime_value["alternate_title"].asString()));
+    anime_item.SetEpisodeCount(anime_value["episode_count"].asInt());
+    anime_item.SetImageUrl(StrToWstr(anime_value["cover_image"].asString()));
+    anime_item.SetSynopsis(StrToWstr(anime_value["synopsis"].asString()));
+    anime_item.SetType(TranslateSeriesTypeFrom(StrToWstr(anime_value["show_type"].asString())));
+    std::vector<std::wstring> genres;
+    auto& genres_value = anime_value["genres"];
+    for (size_t j = 0; j < genres_value.size(); j++)
+      genres.push_back(StrToWstr(genres_value[j]["name"].asString()));
+    if (!genres.empty())
+      anime_item.SetGenres(genres);
+
+    anime_item.AddtoUserList();
+    anime_item.SetMyLastWatchedEpisode(value["episodes_watched"].asInt());
+    anime_item.SetMyStatus(TranslateMyStatusFrom(StrToWstr(value["status"].asString())));
+    anime_item.SetMyRewatching(value["rewatching"].asBool());
+    anime_item.SetMyScore(TranslateMyRatingFrom(StrToWstr(rating_value["value"].asString()),
+                                                StrToWstr(rating_value["type"].asString())));
+
+    anime_items.push_back(anime_item);
+  }
+}
+
+static bool IsSameEntry(const anime::Item& a, const anime::Item& b) {
+  return a.GetId(sync::kHummingbird) == b.GetId(sync::kHummingbird) &&
+         a.GetTitle() == b.GetTitle() &&
+         a.GetSynopsis() == b.GetSynopsis() &&
+         a.GetEpisodeCount() == b.GetEpisodeCount() &&
+         a.GetGenres() == b.GetGenres() &&
+         a.GetMyLastWatchedEpisode(false) ==
+             b.GetMyLastWatchedEpisode(false) &&
+         a.GetMyStatus(false) == b.GetMyStatus(false) &&
+         a.GetMyScore(false) == b.GetMyScore(false);
+}
+
+bool BenchmarkJson(const std::wstring& path, size_t list_size,
+                   size_t iterations) {
+  // Bodies are decoded before they are handled, so that is not measured
+  std::string data = GenerateHummingbirdLibrary(list_size);
+  std::wstring body = StrToWstr(data);
+
+  sync::hummingbird::Service service;
+  std::vector<anime::Item> jsoncpp_items;
+  std::vector<anime::Item> reader_items;
+  double jsoncpp_total = 0.0;
+  double reader_total = 0.0;
+  Tester tester;
+
+  for (size_t i = 0; i < iterations; i++) {
+    jsoncpp_items.clear();
+    tester.Start();
+    ParseHummingbirdLibrary(body, jsoncpp_items);
+    jsoncpp_total += tester.End(L"", false);
+
+    sync::Response response;
+    response.service_id = sync::kHummingbird;
+    response.type = sync::kGetLibraryEntries;
+    HttpResponse http_response;
+    http_response.code = 200;
+    http_response.body = body;
+    tester.Start();
+    service.HandleResponse(response, http_response);
+    reader_total += tester.End(L"", false);
+    reader_items.swap(response.items);
+  }
+
+  size_t mismatches = 0;
+  if (jsoncpp_items.size() == reader_items.size()) {
+    for (size_t i = 0; i < reader_items.size(); i++)
+      if (!IsSameEntry(jsoncpp_items[i], reader_items[i]))
+        mismatches++;
+  } else {
+    mismatches = max(jsoncpp_items.size(), reader_items.size());
+  }
+
+  Json::Value root;
+  root["list_size"] = static_cast<Json::UInt>(list_size);
+  root["iterations"] = static_cast<Json::UInt>(iterations);
+  root["payload_size"] = static_cast<Json::UInt>(data.size());
+  root["entries"] = static_cast<Json::UInt>(reader_items.size());
+  root["mismatches"] = static_cast<Json::UInt>(mismatches);
+
+  const char* parser_names[] = {"jsoncpp", "reader"};
+  double totals[] = {jsoncpp_total, reader_total};
+  Json::Value& parsers = root["parsers"];
+  for (int i = 0; i < 2; i++) {
+    double average = iterations ? totals[i] / iterations : 0.0;
+    Json::Value parser;
+    parser["name"] = parser_names[i];
+    parser["total_ms"] = totals[i];
+    parser["average_ms"] = average;
+    parser["entries_per_second"] =
+        average > 0.0 ? reader_items.size() / (average / 1000.0) : 0.0;
+    parsers.append(parser);
+  }
+
+  Json::StyledWriter writer;
+  std::string output = writer.write(root);
+
+  return SaveToFile((LPCVOID)output.data(), output.size(), path);
+}
+
 } // namespace debug
\ No newline at end of file
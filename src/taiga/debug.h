@@ -28,7 +28,7 @@ class Tester {
   Tester();
 
   void Start();
-  void End(std::wstring str, bool display_result);
+  double End(std::wstring str, bool display_result);
 
  private:
   double frequency_;
@@ -38,6 +38,25 @@ class Tester {
 void Print(std::wstring text);
 void Test();
 
+// Processes a synthetic feed through each stage of the feed pipeline, and
+// writes the timings of each stage to a JSON report.
+bool BenchmarkFeeds(const std::wstring& path, size_t item_count = 5000,
+                    size_t iterations = 5, bool user_filters = true);
+
+// Runs synchronization cycles of the active service against a local server
+// that stands in for it, and writes the timings, request counts, bytes
+// transferred and the number of changed list entries to a JSON report. Entries
+// that are added to the database during the benchmark are removed afterwards.
+bool BenchmarkSync(const std::wstring& path, size_t list_size = 1000,
+                   size_t cycles = 5, unsigned int latency = 50,
+                   unsigned int error_rate = 0);
+
+// Parses a synthetic Hummingbird list with jsoncpp, as the service used to,
+// and with the service's own reader. Writes the timings to a JSON report,
+// along with the number of entries that were parsed differently.
+bool BenchmarkJson(const std::wstring& path, size_t list_size = 5000,
+                   size_t iterations = 5);
+
 }  // namespace debug
 
 #endif  // TAIGA_TAIGA_DEBUG_H
\ No newline at end of file
@@ -0,0 +1,572 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <winsock2.h>
+
+#include "base/foreach.h"
+#include "base/string.h"
+#include "taiga/debug_server.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace debug {
+
+// Synthetic IDs are chosen from a range that is not used by the services
+const int kFirstSeriesId = 900000;
+// Number of entries that are returned for each search
+const int kSearchResultCount = 5;
+
+static std::string ToStr(int value) {
+  return WstrToStr(ToWstr(value));
+}
+
+static bool StartsWith(const std::string& str, const char* prefix) {
+  return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static bool EndsWith(const std::string& str, const char* suffix) {
+  size_t length = strlen(suffix);
+  return str.size() >= length &&
+         str.compare(str.size() - length, length, suffix) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int GetEpisodeCount(int index) {
+  return 12 * (index % 3 + 1);
+}
+
+static int GetWatchedEpisodes(int index) {
+  return index % (GetEpisodeCount(index) + 1);
+}
+
+static std::string GetSlug(int index) {
+  return "taiga-benchmark-" + ToStr(index + 1);
+}
+
+static std::string GetTitle(int index) {
+  return "Benchmark Series " + ToStr(index + 1);
+}
+
+static int GetIndexFromMalId(const std::string& id) {
+  return max(atoi(id.c_str()) - kFirstSeriesId, 0);
+}
+
+static int GetIndexFromSlug(const std::string& slug) {
+  size_t pos = slug.find_last_of('-');
+  if (pos == std::string::npos)
+    return 0;
+  return max(atoi(slug.c_str() + pos + 1) - 1, 0);
+}
+
+static std::string GetMalEntry(int index) {
+  static const int statuses[] = {1, 2, 3, 4, 6};
+
+  return "<anime>"
+         "<series_animedb_id>" + ToStr(kFirstSeriesId + index) +
+         "</series_animedb_id>"
+         "<series_title>" + GetTitle(index) + "</series_title>"
+         "<series_synonyms></series_synonyms>"
+         "<series_type>1</series_type>"
+         "<series_episodes>" + ToStr(GetEpisodeCount(index)) +
+         "</series_episodes>"
+         "<series_status>2</series_status>"
+         "<series_start>2010-01-01</series_start>"
+         "<series_end>2010-06-30</series_end>"
+         "<series_image></series_image>"
+         "<my_id>0</my_id>"
+         "<my_watched_episodes>" + ToStr(GetWatchedEpisodes(index)) +
+         "</my_watched_episodes>"
+         "<my_start_date>0000-00-00</my_start_date>"
+         "<my_finish_date>0000-00-00</my_finish_date>"
+         "<my_score>" + ToStr(index % 11) + "</my_score>"
+         "<my_status>" + ToStr(statuses[index % 5]) + "</my_status>"
+         "<my_rewatching>0</my_rewatching>"
+         "<my_rewatching_ep>0</my_rewatching_ep>"
+         "<my_last_updated>1388534400</my_last_updated>"
+         "<my_tags></my_tags>"
+         "</anime>";
+}
+
+static std::string GetMalSearchEntry(int index) {
+  return "<entry>"
+         "<id>" + ToStr(kFirstSeriesId + index) + "</id>"
+         "<title>" + GetTitle(index) + "</title>"
+         "<english></english>"
+         "<synonyms></synonyms>"
+         "<episodes>" + ToStr(GetEpisodeCount(index)) + "</episodes>"
+         "<score>7.50</score>"
+         "<type>TV</type>"
+         "<status>Finished Airing</status>"
+         "<start_date>2010-01-01</start_date>"
+         "<end_date>2010-06-30</end_date>"
+         "<synopsis></synopsis>"
+         "<image></image>"
+         "</entry>";
+}
+
+static std::string GetMalMetadata(int index) {
+  return "<div class=\"hoverinfo_content\">"
+         "<a href=\"http://myanimelist.net/anime/" +
+         ToStr(kFirstSeriesId + index) + "/\" class=\"hovertitle\">" +
+         GetTitle(index) + " (2010)</a><br />"
+         "<span class=\"dark_text\">Genres:</span> Action, Comedy<br />"
+         "<span class=\"dark_text\">Score:</span> 7.50<br />"
+         "<span class=\"dark_text\">Popularity:</span> #" +
+         ToStr(index + 1) + "<br />"
+         "</div>";
+}
+
+static std::string GetHummingbirdAnime(int index) {
+  return "{\"slug\":\"" + GetSlug(index) + "\","
+         "\"status\":\"Finished Airing\","
+         "\"title\":\"" + GetTitle(index) + "\","
+         "\"alternate_title\":\"\","
+         "\"episode_count\":" + ToStr(GetEpisodeCount(index)) + ","
+         "\"cover_image\":\"\","
+         "\"synopsis\":\"A series that is generated for benchmarking.\\n"
+         "\\\"Quoted\\\" text and \\u00e9scaped characters.\","
+         "\"show_type\":\"TV\","
+         "\"genres\":[{\"name\":\"Action\"},{\"name\":\"Comedy\"}]}";
+}
+
+static std::string GetHummingbirdEntry(int index) {
+  static const char* statuses[] = {
+      "currently-watching", "completed", "on-hold", "dropped", "plan-to-watch"};
+
+  return "{\"episodes_watched\":" + ToStr(GetWatchedEpisodes(index)) + ","
+         "\"status\":\"" + statuses[index % 5] + "\","
+         "\"rewatching\":false,"
+         "\"rating\":{\"type\":\"advanced\",\"value\":\"" +
+         ToStr(index % 6) + ".0\"},"
+         "\"anime\":" + GetHummingbirdAnime(index) + "}";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::string GetHeaderValue(const std::string& header,
+                                  const char* name) {
+  size_t name_length = strlen(name);
+
+  // The first line is the request line
+  size_t pos = header.find("\r\n");
+  while (pos != std::string::npos) {
+    pos += 2;
+    size_t end = header.find("\r\n", pos);
+    std::string line = header.substr(
+        pos, end == std::string::npos ? std::string::npos : end - pos);
+    if (line.size() > name_length && line[name_length] == ':' &&
+        _strnicmp(line.c_str(), name, name_length) == 0) {
+      size_t value = line.find_first_not_of(' ', name_length + 1);
+      return value == std::string::npos ? std::string() : line.substr(value);
+    }
+    pos = end;
+  }
+
+  return std::string();
+}
+
+static std::string GetQueryValue(const std::string& query, const char* name) {
+  std::string prefix = std::string(name) + "=";
+
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t end = query.find('&', pos);
+    if (end == std::string::npos)
+      end = query.size();
+    if (query.compare(pos, prefix.size(), prefix) == 0)
+      return query.substr(pos + prefix.size(), end - pos - prefix.size());
+    pos = end + 1;
+  }
+
+  return std::string();
+}
+
+static const char* GetReasonPhrase(unsigned int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 404: return "Not Found";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    default: return "Error";
+  }
+}
+
+static bool SendAll(SOCKET socket, const std::string& data) {
+  size_t sent = 0;
+
+  while (sent < data.size()) {
+    int result = send(socket, data.data() + sent,
+                      static_cast<int>(data.size() - sent), 0);
+    if (result == SOCKET_ERROR)
+      return false;
+    sent += result;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ApiServer::Options::Options()
+    : error_code(503),
+      error_rate(0),
+      latency(0),
+      list_size(1000) {
+}
+
+ApiServer::Statistics::Statistics()
+    : bytes_received(0),
+      bytes_sent(0),
+      errors(0) {
+  for (int i = 0; i <= sync::kUpdateLibraryEntry; i++)
+    requests[i] = 0;
+}
+
+ApiServer::ApiServer()
+    : listen_socket_(INVALID_SOCKET),
+      active_connections_(0),
+      request_count_(0) {
+}
+
+ApiServer::~ApiServer() {
+  Stop();
+}
+
+bool ApiServer::Start() {
+  WSADATA wsa_data;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+    return false;
+
+  SOCKET listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listen_socket == INVALID_SOCKET) {
+    WSACleanup();
+    return false;
+  }
+
+  // The port is chosen by the system
+  sockaddr_in address = {0};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int address_length = sizeof(address);
+
+  if (bind(listen_socket, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) == SOCKET_ERROR ||
+      listen(listen_socket, SOMAXCONN) == SOCKET_ERROR ||
+      getsockname(listen_socket, reinterpret_cast<sockaddr*>(&address),
+                  &address_length) == SOCKET_ERROR) {
+    closesocket(listen_socket);
+    WSACleanup();
+    return false;
+  }
+
+  host_ = L"127.0.0.1:" + ToWstr(static_cast<int>(ntohs(address.sin_port)));
+  listen_socket_ = listen_socket;
+
+  GenerateLibrary();
+
+  if (!CreateThread(nullptr, 0, 0)) {
+    closesocket(listen_socket);
+    listen_socket_ = INVALID_SOCKET;
+    WSACleanup();
+    return false;
+  }
+
+  return true;
+}
+
+void ApiServer::Stop() {
+  if (listen_socket_ == INVALID_SOCKET)
+    return;
+
+  // Closing the socket makes the blocking call in the server thread return
+  closesocket(listen_socket_);
+  listen_socket_ = INVALID_SOCKET;
+  ::WaitForSingleObject(GetThreadHandle(), INFINITE);
+  CloseThreadHandle();
+
+  // Connections that are kept alive are closed from our side
+  {
+    win::Lock lock(critical_section_);
+    foreach_(it, connections_)
+      shutdown(*it, SD_BOTH);
+  }
+  while (active_connections_ > 0)
+    ::Sleep(10);
+
+  WSACleanup();
+}
+
+DWORD ApiServer::ThreadProc() {
+  SOCKET listen_socket = listen_socket_;
+
+  while (true) {
+    SOCKET client_socket = accept(listen_socket, nullptr, nullptr);
+    if (client_socket == INVALID_SOCKET)
+      break;
+
+    {
+      win::Lock lock(critical_section_);
+      connections_.insert(client_socket);
+    }
+    InterlockedIncrement(&active_connections_);
+
+    Connection* connection = new Connection;
+    connection->server = this;
+    connection->socket = client_socket;
+
+    // Connections are served on the thread pool, as the latency is simulated
+    // with blocking waits
+    if (!::QueueUserWorkItem(ConnectionProc, connection,
+                             WT_EXECUTELONGFUNCTION))
+      ConnectionProc(connection);
+  }
+
+  return 0;
+}
+
+const std::wstring& ApiServer::host() const {
+  return host_;
+}
+
+DWORD WINAPI ApiServer::ConnectionProc(LPVOID parameter) {
+  Connection* connection = static_cast<Connection*>(parameter);
+  ApiServer* server = connection->server;
+
+  server->HandleConnection(connection->socket);
+
+  {
+    win::Lock lock(server->critical_section_);
+    server->connections_.erase(connection->socket);
+  }
+  closesocket(connection->socket);
+  delete connection;
+
+  InterlockedDecrement(&server->active_connections_);
+  return 0;
+}
+
+std::string GenerateHummingbirdLibrary(size_t list_size) {
+  std::string library = "[";
+
+  for (int i = 0; i < static_cast<int>(list_size); i++) {
+    if (i > 0)
+      library += ",";
+    library += GetHummingbirdEntry(i);
+  }
+
+  library += "]";
+  return library;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ApiServer::GenerateLibrary() {
+  int list_size = static_cast<int>(options.list_size);
+
+  library_xml_ =
+      "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"
+      "<myanimelist>"
+      "<myinfo>"
+      "<user_id>1</user_id>"
+      "<user_name>" + options.username + "</user_name>"
+      "</myinfo>";
+  for (int i = 0; i < list_size; i++)
+    library_xml_ += GetMalEntry(i);
+  library_xml_ += "</myanimelist>";
+
+  library_json_ = GenerateHummingbirdLibrary(options.list_size);
+}
+
+void ApiServer::HandleConnection(UINT_PTR socket) {
+  std::string buffer;
+  char chunk[8192];
+
+  while (true) {
+    // Read the request header
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      int result = recv(socket, chunk, sizeof(chunk), 0);
+      if (result <= 0)
+        return;
+      InterlockedExchangeAdd(&statistics.bytes_received, result);
+      buffer.append(chunk, result);
+    }
+    std::string header = buffer.substr(0, header_end);
+
+    // Read the request body, which we don't need other than to skip it
+    size_t request_size = header_end + 4 +
+        atoi(GetHeaderValue(header, "Content-Length").c_str());
+    while (buffer.size() < request_size) {
+      int result = recv(socket, chunk, sizeof(chunk), 0);
+      if (result <= 0)
+        return;
+      InterlockedExchangeAdd(&statistics.bytes_received, result);
+      buffer.append(chunk, result);
+    }
+    buffer.erase(0, request_size);
+
+    // Request line is in the form of "METHOD target HTTP/1.1"
+    std::string target = header.substr(0, header.find("\r\n"));
+    size_t target_begin = target.find(' ');
+    if (target_begin == std::string::npos)
+      return;
+    target = target.substr(target_begin + 1);
+    target = target.substr(0, target.find(' '));
+
+    bool keep_alive = _stricmp(GetHeaderValue(header, "Connection").c_str(),
+                               "close") != 0;
+
+    if (options.latency > 0)
+      ::Sleep(options.latency);
+
+    unsigned int code = 200;
+    std::string content_type = "text/plain";
+    std::string body;
+    sync::RequestType request_type =
+        HandleRequest(target, code, content_type, body);
+    InterlockedIncrement(&statistics.requests[request_type]);
+
+    if (InjectError()) {
+      InterlockedIncrement(&statistics.errors);
+      code = options.error_code;
+      content_type = "application/json";
+      body = "{\"error\":\"" + std::string(GetReasonPhrase(code)) + "\"}";
+    }
+
+    std::string response =
+        "HTTP/1.1 " + ToStr(code) + " " + GetReasonPhrase(code) + "\r\n"
+        "Content-Type: " + content_type + "; charset=utf-8\r\n"
+        "Content-Length: " + ToStr(static_cast<int>(body.size())) + "\r\n";
+    if (!keep_alive)
+      response += "Connection: close\r\n";
+    response += "\r\n" + body;
+
+    if (!SendAll(socket, response))
+      return;
+    InterlockedExchangeAdd(&statistics.bytes_sent,
+                           static_cast<LONG>(response.size()));
+
+    if (!keep_alive)
+      return;
+  }
+}
+
+sync::RequestType ApiServer::HandleRequest(const std::string& target,
+                                           unsigned int& code,
+                                           std::string& content_type,
+                                           std::string& body) {
+  size_t query_begin = target.find('?');
+  std::string path = target.substr(0, query_begin);
+  std::string query = query_begin != std::string::npos ?
+      target.substr(query_begin + 1) : std::string();
+
+  // MyAnimeList
+  if (path == "/api/account/verify_credentials.xml") {
+    content_type = "text/xml";
+    body = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+           "<user><id>1</id><username>" + options.username + "</username>"
+           "</user>";
+    return sync::kAuthenticateUser;
+  }
+  if (path == "/malappinfo.php") {
+    content_type = "text/xml";
+    body = library_xml_;
+    return sync::kGetLibraryEntries;
+  }
+  if (path == "/includes/ajax.inc.php") {
+    content_type = "text/html";
+    body = GetMalMetadata(GetIndexFromMalId(GetQueryValue(query, "id")));
+    return sync::kGetMetadataById;
+  }
+  if (path == "/api/anime/search.xml") {
+    content_type = "text/xml";
+    body = "<?xml version=\"1.0\" encoding=\"utf-8\"?><anime>";
+    for (int i = 0; i < kSearchResultCount; i++)
+      body += GetMalSearchEntry(i);
+    body += "</anime>";
+    return sync::kSearchTitle;
+  }
+  if (StartsWith(path, "/api/animelist/add/")) {
+    code = 201;
+    body = "1";
+    return sync::kAddLibraryEntry;
+  }
+  if (StartsWith(path, "/api/animelist/delete/")) {
+    body = "Deleted";
+    return sync::kDeleteLibraryEntry;
+  }
+  if (StartsWith(path, "/api/animelist/update/")) {
+    body = "Updated";
+    return sync::kUpdateLibraryEntry;
+  }
+
+  // Hummingbird
+  if (path == "/users/authenticate") {
+    content_type = "application/json";
+    body = "\"taiga-benchmark-token\"";
+    return sync::kAuthenticateUser;
+  }
+  if (StartsWith(path, "/users/") && EndsWith(path, "/library")) {
+    content_type = "application/json";
+    body = library_json_;
+    return sync::kGetLibraryEntries;
+  }
+  if (StartsWith(path, "/anime/")) {
+    content_type = "application/json";
+    body = GetHummingbirdAnime(GetIndexFromSlug(path));
+    return sync::kGetMetadataById;
+  }
+  if (path == "/search/anime") {
+    content_type = "application/json";
+    body = "[";
+    for (int i = 0; i < kSearchResultCount; i++)
+      body += (i > 0 ? "," : "") + GetHummingbirdAnime(i);
+    body += "]";
+    return sync::kSearchTitle;
+  }
+  if (StartsWith(path, "/libraries/")) {
+    content_type = "application/json";
+    if (EndsWith(path, "/remove")) {
+      body = "true";
+      return sync::kDeleteLibraryEntry;
+    }
+    body = "{}";
+    return sync::kUpdateLibraryEntry;
+  }
+
+  code = 404;
+  body = "Not Found";
+  return sync::kGenericRequest;
+}
+
+// Errors are spread evenly over the requests, rather than being random, so
+// that the results of separate runs can be compared
+bool ApiServer::InjectError() {
+  if (options.error_rate == 0)
+    return false;
+
+  unsigned int count = static_cast<unsigned int>(
+      InterlockedIncrement(&request_count_));
+  return (count * options.error_rate) % 100 < options.error_rate;
+}
+
+}  // namespace debug
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAIGA_TAIGA_DEBUG_SERVER_H
+#define TAIGA_TAIGA_DEBUG_SERVER_H
+
+#include <set>
+#include <string>
+
+#include "sync/service.h"
+#include "win/win_thread.h"
+
+namespace debug {
+
+// A loopback HTTP server that stands in for the APIs of MyAnimeList and
+// Hummingbird. Responses are generated for each type of request, with a
+// configurable delay and error rate, so that the sync pipeline can be measured
+// without reaching the actual services.
+
+class ApiServer : public win::Thread {
+public:
+  ApiServer();
+  ~ApiServer();
+
+  bool Start();
+  void Stop();
+
+  DWORD ThreadProc();
+
+  const std::wstring& host() const;
+
+  // Options must be set before the server is started
+  class Options {
+  public:
+    Options();
+
+    unsigned int error_code;
+    unsigned int error_rate;  // percentage of requests
+    unsigned int latency;     // milliseconds
+    size_t list_size;
+    std::string username;
+  } options;
+
+  class Statistics {
+  public:
+    Statistics();
+
+    volatile LONG bytes_received;
+    volatile LONG bytes_sent;
+    volatile LONG errors;
+    volatile LONG requests[sync::kUpdateLibraryEntry + 1];
+  } statistics;
+
+private:
+  class Connection {
+  public:
+    ApiServer* server;
+    UINT_PTR socket;
+  };
+
+  static DWORD WINAPI ConnectionProc(LPVOID parameter);
+
+  void GenerateLibrary();
+  void HandleConnection(UINT_PTR socket);
+  sync::RequestType HandleRequest(const std::string& target,
+                                  unsigned int& code,
+                                  std::string& content_type,
+                                  std::string& body);
+  bool InjectError();
+
+  std::set<UINT_PTR> connections_;
+  win::CriticalSection critical_section_;
+  std::wstring host_;
+  std::string library_json_;
+  std::string library_xml_;
+  UINT_PTR listen_socket_;
+  volatile LONG active_connections_;
+  volatile LONG request_count_;
+};
+
+// Returns a list in the format of Hummingbird, as served by the server above
+std::string GenerateHummingbirdLibrary(size_t list_size);
+
+}  // namespace debug
+
+#endif  // TAIGA_TAIGA_DEBUG_SERVER_H
\ No newline at end of file
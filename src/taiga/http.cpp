@@ -37,6 +37,36 @@ namespace taiga {
 // See: http://www.browserscope.org/?category=network
 const unsigned int kMaxSimultaneousConnections = 10;
 const unsigned int kMaxSimultaneousConnectionsPerHostname = 6;
+// Background requests leave this many connections free, so that the requests
+// that the user is waiting for can be started right away.
+const unsigned int kReservedInteractiveConnections = 1;
+
+HttpPriority GetHttpPriority(HttpClientMode mode) {
+  switch (mode) {
+    case kHttpServiceAuthenticateUser:
+    case kHttpServiceAddLibraryEntry:
+    case kHttpServiceDeleteLibraryEntry:
+    case kHttpServiceGetLibraryEntries:
+    case kHttpServiceUpdateLibraryEntry:
+      return kHttpPriorityInteractive;
+    case kHttpFeedCheck:
+    case kHttpFeedCheckAuto:
+    case kHttpFeedDownload:
+    case kHttpFeedDownloadAll:
+      return kHttpPriorityFeed;
+    case kHttpGetLibraryEntryImage:
+      return kHttpPriorityImage;
+    case kHttpTaigaUpdateCheck:
+    case kHttpTaigaUpdateDownload:
+      return kHttpPriorityUpdate;
+    case kHttpServiceGetMetadataById:
+    case kHttpServiceSearchTitle:
+    default:
+      return kHttpPriorityMetadata;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
 HttpClient::HttpClient()
     : mode_(kHttpSilent) {
@@ -50,6 +80,12 @@ HttpClient::HttpClient()
   set_proxy(Settings[kApp_Connection_ProxyHost],
             Settings[kApp_Connection_ProxyUsername],
             Settings[kApp_Connection_ProxyPassword]);
+
+  // Connections are kept alive for later requests, up to the same limit that
+  // we have for simultaneous connections to each host
+  ConfigurePool(max(Settings.GetInt(kApp_Connection_IdleTimeout), 0),
+                max(Settings.GetInt(kApp_Connection_MaxPoolSize), 0),
+                kMaxSimultaneousConnectionsPerHostname);
 }
 
 HttpClientMode HttpClient::mode() const {
@@ -88,7 +124,7 @@ bool HttpClient::OnRedirect(const std::wstring& address) {
   switch (mode()) {
     case kHttpTaigaUpdateDownload: {
       std::wstring file = address.substr(address.find_last_of(L"/") + 1);
-      download_path_ = GetPathOnly(download_path_) + file;
+      set_download_path(GetPathOnly(download_path_) + file);
       Taiga.Updater.SetDownloadPath(download_path_);
       break;
     }
@@ -117,38 +153,212 @@ bool HttpClient::OnReadComplete() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Bodies are decoded as text only for requests that need them as text. Files
+// are written as they are downloaded, if the client has a download path.
+static void SelectSink(HttpClient& client) {
+  if (client.sink_type() == win::http::kSinkFile)
+    return;
+
+  switch (client.mode()) {
+    case kHttpFeedCheck:
+    case kHttpFeedCheckAuto:
+    case kHttpFeedDownload:
+    case kHttpFeedDownloadAll:
+      client.set_sink_type(win::http::kSinkRaw);
+      break;
+    default:
+      client.set_sink_type(win::http::kSinkText);
+      break;
+  }
+}
+
+HttpRequestQueue::Host::Host()
+    : connections(0) {
+  for (int i = 0; i < kHttpPriorityCount; i++)
+    waiting[i] = false;
+}
+
+HttpRequestQueue::HttpRequestQueue(unsigned int max_connections,
+                                   unsigned int max_host_connections,
+                                   unsigned int reserved_connections)
+    : connections_(0),
+      max_connections_(max_connections),
+      max_host_connections_(max_host_connections),
+      reserved_connections_(reserved_connections) {
+}
+
+void HttpRequestQueue::Add(const HttpRequest& request, HttpPriority priority) {
+  // A request that is made again replaces the one that is still queued
+  Cancel(request.uuid);
+
+  Host& host = hosts_[request.host];
+  RequestList& requests = host.requests[priority];
+  requests.push_back(request);
+
+  Location& location = locations_[request.uuid];
+  location.host = &host;
+  location.priority = priority;
+  location.request = --requests.end();
+
+  UpdateTurns(host);
+}
+
+bool HttpRequestQueue::Cancel(const base::uuid_t& uuid) {
+  auto it = locations_.find(uuid);
+  if (it == locations_.end())
+    return false;
+
+  Host& host = *it->second.host;
+  host.requests[it->second.priority].erase(it->second.request);
+  locations_.erase(it);
+
+  UpdateTurns(host);
+  return true;
+}
+
+bool HttpRequestQueue::Next(HttpRequest& request) {
+  for (int i = 0; i < kHttpPriorityCount; i++) {
+    if (connections_ >= max_connections_) {
+      LOG(LevelDebug, L"Reached max connections");
+      return false;
+    }
+    if (i > kHttpPriorityInteractive &&
+        connections_ + reserved_connections_ >= max_connections_)
+      return false;
+
+    HostList& turns = turns_[i];
+    if (turns.empty())
+      continue;
+
+    // The host goes to the back of the line, if it has more requests to start
+    Host& host = *turns.front();
+    turns.pop_front();
+    host.waiting[i] = false;
+
+    request = host.requests[i].front();
+    host.requests[i].pop_front();
+    locations_.erase(request.uuid);
+
+    connections_++;
+    host.connections++;
+    UpdateTurns(host);
+    return true;
+  }
+
+  return false;
+}
+
+void HttpRequestQueue::AddConnection(const std::wstring& host_name) {
+  Host& host = hosts_[host_name];
+
+  connections_++;
+  host.connections++;
+  UpdateTurns(host);
+}
+
+void HttpRequestQueue::FreeConnection(const std::wstring& host_name) {
+  Host& host = hosts_[host_name];
+
+  if (host.connections > 0) {
+    connections_--;
+    host.connections--;
+  } else {
+    LOG(LevelError, L"Connections for hostname was already zero: " + host_name);
+  }
+
+  UpdateTurns(host);
+}
+
+bool HttpRequestQueue::empty() const {
+  return locations_.empty();
+}
+
+bool HttpRequestQueue::IsAvailable(const Host& host) const {
+  return host.connections < max_host_connections_;
+}
+
+void HttpRequestQueue::UpdateTurns(Host& host) {
+  bool available = IsAvailable(host);
+
+  for (int i = 0; i < kHttpPriorityCount; i++) {
+    bool waiting = available && !host.requests[i].empty();
+    if (waiting == host.waiting[i])
+      continue;
+    if (waiting) {
+      host.turn[i] = turns_[i].insert(turns_[i].end(), &host);
+    } else {
+      turns_[i].erase(host.turn[i]);
+    }
+    host.waiting[i] = waiting;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+HttpManager::HttpManager()
+    : queue_(kMaxSimultaneousConnections,
+             kMaxSimultaneousConnectionsPerHostname,
+             kReservedInteractiveConnections) {
+}
+
 HttpClient& HttpManager::GetNewClient(const base::uuid_t& uuid) {
-  return clients_[uuid];
+  // Clients cannot be copied, so the map only holds pointers to them
+  auto& client = clients_[uuid];
+  if (!client)
+    client.reset(new HttpClient());
+
+  return *client;
 }
 
 void HttpManager::CancelRequest(base::uuid_t uuid) {
-  if (clients_.count(uuid))
-    clients_[uuid].Cleanup();
+#ifdef TAIGA_WIN_HTTP_MULTITHREADED
+  {
+    win::Lock lock(critical_section_);
+    // Requests that are still in the queue have no connections to free
+    if (queue_.Cancel(uuid))
+      return;
+  }
+#endif
+
+  if (clients_.count(uuid)) {
+    HttpClient& client = *clients_[uuid];
+    std::wstring host = client.request_.host;
+    bool cancelled = client.Cancel();
+    client.Cleanup();
+    // Cancelled transfers are never completed, so their connections have to
+    // be freed here
+    if (cancelled) {
+      FreeConnection(host);
+      ProcessQueue();
+    }
+  }
 }
 
 void HttpManager::MakeRequest(HttpRequest& request, HttpClientMode mode) {
   if (clients_.count(request.uuid)) {
     LOG(LevelWarning, L"HttpClient already exists. ID: " + request.uuid);
-    clients_[request.uuid].Cleanup();
+    clients_[request.uuid]->Cleanup();
   }
 
-  HttpClient& client = clients_[request.uuid];
+  HttpClient& client = GetNewClient(request.uuid);
   client.set_mode(mode);
+  SelectSink(client);
 
-  AddToQueue(request);
+  AddToQueue(request, mode);
   ProcessQueue();
 }
 
 void HttpManager::MakeRequest(HttpClient& client, HttpRequest& request,
                               HttpClientMode mode) {
   client.set_mode(mode);
+  SelectSink(client);
 
-  AddToQueue(request);
+  AddToQueue(request, mode);
   ProcessQueue();
 }
 
 void HttpManager::HandleError(HttpResponse& response, const string_t& error) {
-  HttpClient& client = clients_[response.uuid];
+  HttpClient& client = *clients_[response.uuid];
 
   switch (client.mode()) {
     case kHttpServiceAuthenticateUser:
@@ -160,6 +370,22 @@ void HttpManager::HandleError(HttpResponse& response, const string_t& error) {
     case kHttpServiceUpdateLibraryEntry:
       ServiceManager.HandleHttpError(client.response_, error);
       break;
+    case kHttpFeedCheck:
+    case kHttpFeedCheckAuto: {
+      auto source = reinterpret_cast<FeedSource*>(response.parameter);
+      if (source) {
+        bool automatic = client.mode() == kHttpFeedCheckAuto;
+        Aggregator.HandleFeedCheckError(*source, automatic);
+      }
+      break;
+    }
+    case kHttpFeedDownload:
+    case kHttpFeedDownloadAll: {
+      auto download = reinterpret_cast<FeedDownload*>(response.parameter);
+      if (download)
+        Aggregator.HandleFeedDownloadError(*download);
+      break;
+    }
   }
 
   FreeConnection(client.request_.host);
@@ -173,7 +399,7 @@ void HttpManager::HandleRedirect(const std::wstring& current_host,
 }
 
 void HttpManager::HandleResponse(HttpResponse& response) {
-  HttpClient& client = clients_[response.uuid];
+  HttpClient& client = *clients_[response.uuid];
 
   switch (client.mode()) {
     case kHttpServiceAuthenticateUser:
@@ -188,27 +414,26 @@ void HttpManager::HandleResponse(HttpResponse& response) {
 
     case kHttpGetLibraryEntryImage: {
       int anime_id = static_cast<int>(response.parameter);
-      if (ImageDatabase.Load(anime_id, true, false))
-        ui::OnLibraryEntryImageChange(anime_id);
+      ImageDatabase.OnDownloadComplete(anime_id, response);
       break;
     }
 
     case kHttpFeedCheck:
     case kHttpFeedCheckAuto: {
-      Feed* feed = reinterpret_cast<Feed*>(response.parameter);
-      if (feed) {
+      auto source = reinterpret_cast<FeedSource*>(response.parameter);
+      if (source) {
         bool automatic = client.mode() == kHttpFeedCheckAuto;
-        Aggregator.HandleFeedCheck(*feed, automatic);
+        Aggregator.HandleFeedCheck(*source, response, client.write_buffer(),
+                                   automatic);
       }
       break;
     }
     case kHttpFeedDownload:
     case kHttpFeedDownloadAll: {
-      auto feed = reinterpret_cast<Feed*>(response.parameter);
-      if (feed) {
-        bool download_all = client.mode() == kHttpFeedDownloadAll;
-        Aggregator.HandleFeedDownload(*feed, download_all);
-      }
+      auto download = reinterpret_cast<FeedDownload*>(response.parameter);
+      if (download)
+        Aggregator.HandleFeedDownload(*download, response,
+                                      client.write_buffer());
       break;
     }
 
@@ -238,7 +463,7 @@ void HttpManager::HandleResponse(HttpResponse& response) {
 
 void HttpManager::FreeMemory() {
   for (auto it = clients_.cbegin(); it != clients_.cend(); ) {
-    if (it->second.response().code > 0) {
+    if (it->second->response().code > 0 && !it->second->busy()) {
       clients_.erase(it++);
     } else {
       ++it;
@@ -252,47 +477,35 @@ void HttpManager::Shutdown() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void HttpManager::AddToQueue(HttpRequest& request) {
+void HttpManager::AddToQueue(HttpRequest& request, HttpClientMode mode) {
 #ifdef TAIGA_WIN_HTTP_MULTITHREADED
   win::Lock lock(critical_section_);
 
   LOG(LevelDebug, L"ID: " + request.uuid);
 
-  requests_.push_back(request);
+  queue_.Add(request, GetHttpPriority(mode));
 #else
-  HttpClient& client = clients_[request.uuid];
+  HttpClient& client = GetNewClient(request.uuid);
   client.MakeRequest(request);
 #endif
 }
 
 void HttpManager::ProcessQueue() {
 #ifdef TAIGA_WIN_HTTP_MULTITHREADED
-  win::Lock lock(critical_section_);
-
-  unsigned int connections = 0;
-  foreach_(it, connections_)
-    connections += it->second;
+  std::vector<HttpRequest> requests;
 
-  for (size_t i = 0; i < requests_.size(); i++) {
-    if (connections == kMaxSimultaneousConnections) {
-      LOG(LevelDebug, L"Reached max connections");
-      break;
-    }
-
-    HttpRequest& request = requests_.at(i);
-    if (connections_[request.host] == kMaxSimultaneousConnectionsPerHostname) {
-      LOG(LevelDebug, L"Reached max connections for hostname: " + request.host);
-      continue;
-    } else {
-      connections++;
-      connections_[request.host]++;
-
-      HttpClient& client = clients_[request.uuid];
-      client.MakeRequest(request);
+  {
+    win::Lock lock(critical_section_);
+    HttpRequest request;
+    while (queue_.Next(request))
+      requests.push_back(request);
+  }
 
-      requests_.erase(requests_.begin() + i);
-      i--;
-    }
+  // Clients may have to wait for their previous transfers to complete, and
+  // completion handlers need the lock to free their connections
+  foreach_(it, requests) {
+    HttpClient& client = GetNewClient(it->uuid);
+    client.MakeRequest(*it);
   }
 #endif
 }
@@ -301,7 +514,7 @@ void HttpManager::AddConnection(const string_t& hostname) {
 #ifdef TAIGA_WIN_HTTP_MULTITHREADED
   win::Lock lock(critical_section_);
 
-  connections_[hostname]++;
+  queue_.AddConnection(hostname);
 #endif
 }
 
@@ -309,11 +522,7 @@ void HttpManager::FreeConnection(const string_t& hostname) {
 #ifdef TAIGA_WIN_HTTP_MULTITHREADED
   win::Lock lock(critical_section_);
 
-  if (connections_[hostname] > 0) {
-    connections_[hostname]--;
-  } else {
-    LOG(LevelError, L"Connections for hostname was already zero: " + hostname);
-  }
+  queue_.FreeConnection(hostname);
 #endif
 }
 
@@ -19,7 +19,10 @@
 #ifndef TAIGA_TAIGA_HTTP_H
 #define TAIGA_TAIGA_HTTP_H
 
+#include <list>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 #include "base/types.h"
 #include "win/http/win_http.h"
@@ -53,6 +56,19 @@ enum HttpClientMode {
   kHttpTaigaUpdateDownload
 };
 
+// Requests are started in the order of these classes, so that background
+// transfers cannot hold back the ones that the user is waiting for.
+enum HttpPriority {
+  kHttpPriorityInteractive,
+  kHttpPriorityFeed,
+  kHttpPriorityMetadata,
+  kHttpPriorityImage,
+  kHttpPriorityUpdate,
+  kHttpPriorityCount
+};
+
+HttpPriority GetHttpPriority(HttpClientMode mode);
+
 class HttpClient : public win::http::Client {
 public:
   friend class HttpManager;
@@ -74,8 +90,63 @@ private:
   HttpClientMode mode_;
 };
 
+// Within each priority class, hosts take turns in starting their requests, so
+// that a host with many pending requests cannot hold back the others. Adding,
+// cancelling and starting a request take constant time.
+
+class HttpRequestQueue {
+public:
+  HttpRequestQueue(unsigned int max_connections,
+                   unsigned int max_host_connections,
+                   unsigned int reserved_connections);
+
+  void Add(const HttpRequest& request, HttpPriority priority);
+  bool Cancel(const base::uuid_t& uuid);
+  bool Next(HttpRequest& request);
+
+  void AddConnection(const std::wstring& host);
+  void FreeConnection(const std::wstring& host);
+
+  bool empty() const;
+
+private:
+  class Host;
+  typedef std::list<HttpRequest> RequestList;
+  typedef std::list<Host*> HostList;
+
+  class Host {
+  public:
+    Host();
+
+    unsigned int connections;
+    RequestList requests[kHttpPriorityCount];
+    HostList::iterator turn[kHttpPriorityCount];
+    bool waiting[kHttpPriorityCount];
+  };
+
+  class Location {
+  public:
+    Host* host;
+    HttpPriority priority;
+    RequestList::iterator request;
+  };
+
+  bool IsAvailable(const Host& host) const;
+  void UpdateTurns(Host& host);
+
+  std::unordered_map<std::wstring, Host> hosts_;
+  std::unordered_map<base::uuid_t, Location> locations_;
+  HostList turns_[kHttpPriorityCount];
+  unsigned int connections_;
+  unsigned int max_connections_;
+  unsigned int max_host_connections_;
+  unsigned int reserved_connections_;
+};
+
 class HttpManager {
 public:
+  HttpManager();
+
   HttpClient& GetNewClient(const base::uuid_t& uuid);
 
   void CancelRequest(base::uuid_t uuid);
@@ -90,15 +161,14 @@ public:
   void Shutdown();
 
 private:
-  void AddToQueue(HttpRequest& request);
+  void AddToQueue(HttpRequest& request, HttpClientMode mode);
   void ProcessQueue();
   void AddConnection(const string_t& hostname);
   void FreeConnection(const string_t& hostname);
 
-  std::map<std::wstring, HttpClient> clients_;
-  std::map<std::wstring, unsigned int> connections_;
+  std::map<std::wstring, std::unique_ptr<HttpClient>> clients_;
   win::CriticalSection critical_section_;
-  std::vector<HttpRequest> requests_;
+  HttpRequestQueue queue_;
 };
 
 }  // namespace taiga
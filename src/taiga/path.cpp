@@ -56,12 +56,20 @@ std::wstring GetPath(PathType type) {
       return data_path + L"db\\";
     case kPathDatabaseAnime:
       return data_path + L"db\\anime.xml";
+    case kPathDatabaseCache:
+      return data_path + L"db\\cache\\";
+    case kPathDatabaseCacheIndex:
+      return data_path + L"db\\cache\\index.xml";
     case kPathDatabaseImage:
       return data_path + L"db\\image\\";
+    case kPathDatabaseImageIndex:
+      return data_path + L"db\\image\\index.xml";
     case kPathDatabaseSeason:
       return data_path + L"db\\season\\";
     case kPathFeed:
       return data_path + L"feed\\";
+    case kPathFeedArchive:
+      return data_path + L"feed\\archive.dat";
     case kPathFeedHistory:
       return data_path + L"feed\\history.xml";
     case kPathMedia:
@@ -27,9 +27,13 @@ enum PathType {
   kPathData,
   kPathDatabase,
   kPathDatabaseAnime,
+  kPathDatabaseCache,
+  kPathDatabaseCacheIndex,
   kPathDatabaseImage,
+  kPathDatabaseImageIndex,
   kPathDatabaseSeason,
   kPathFeed,
+  kPathFeedArchive,
   kPathFeedHistory,
   kPathMedia,
   kPathSettings,
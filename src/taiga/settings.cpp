@@ -177,6 +177,10 @@ void AppSettings::InitializeMap() {
   INITKEY(kSync_Service_Mal_Password, nullptr, L"account/myanimelist/password");
   INITKEY(kSync_Service_Hummingbird_Username, nullptr, L"account/hummingbird/username");
   INITKEY(kSync_Service_Hummingbird_Password, nullptr, L"account/hummingbird/password");
+  INITKEY(kSync_Service_Mal_RequestRate, L"2", L"account/myanimelist/requestrate");
+  INITKEY(kSync_Service_Mal_RequestBurst, L"5", L"account/myanimelist/requestburst");
+  INITKEY(kSync_Service_Hummingbird_RequestRate, L"2", L"account/hummingbird/requestrate");
+  INITKEY(kSync_Service_Hummingbird_RequestBurst, L"5", L"account/hummingbird/requestburst");
 
   // Library
   INITKEY(kLibrary_WatchFolders, L"true", L"anime/folders/watch/enabled");
@@ -199,6 +203,8 @@ void AppSettings::InitializeMap() {
   INITKEY(kApp_Connection_ProxyHost, nullptr, L"program/proxy/host");
   INITKEY(kApp_Connection_ProxyUsername, nullptr, L"program/proxy/username");
   INITKEY(kApp_Connection_ProxyPassword, nullptr, L"program/proxy/password");
+  INITKEY(kApp_Connection_IdleTimeout, L"30", L"program/connection/idletimeout");
+  INITKEY(kApp_Connection_MaxPoolSize, L"10", L"program/connection/maxpoolsize");
   INITKEY(kApp_Interface_Theme, L"Default", L"program/general/theme");
   INITKEY(kApp_Interface_ExternalLinks, kDefaultExternalLinks.c_str(), L"program/general/externallinks");
 
@@ -246,6 +252,7 @@ void AppSettings::InitializeMap() {
   INITKEY(kTorrent_Discovery_AutoCheckEnabled, L"true", L"rss/torrent/options/autocheck");
   INITKEY(kTorrent_Discovery_AutoCheckInterval, L"60", L"rss/torrent/options/checkinterval");
   INITKEY(kTorrent_Discovery_NewAction, L"1", L"rss/torrent/options/newaction");
+  INITKEY(kTorrent_Discovery_SaveCache, L"false", L"rss/torrent/options/savecache");
   INITKEY(kTorrent_Download_AppMode, L"1", L"rss/torrent/application/mode");
   INITKEY(kTorrent_Download_AppPath, nullptr, L"rss/torrent/application/path");
   INITKEY(kTorrent_Download_Location, nullptr, L"rss/torrent/options/downloadpath");
@@ -254,6 +261,7 @@ void AppSettings::InitializeMap() {
   INITKEY(kTorrent_Download_CreateSubfolder, nullptr, L"rss/torrent/options/autocreatefolder");
   INITKEY(kTorrent_Filter_Enabled, L"true", L"rss/torrent/filter/enabled");
   INITKEY(kTorrent_Filter_ArchiveMaxCount, L"1000", L"rss/torrent/filter/archive_maxcount");
+  INITKEY(kTorrent_Filter_ArchiveMaxAge, L"0", L"rss/torrent/filter/archive_maxage");
 
   // Internal
   INITKEY(kApp_Position_X, L"-1", L"program/position/x");
@@ -412,7 +420,7 @@ bool AppSettings::Load() {
   auto feed = Aggregator.Get(kFeedCategoryLink);
   if (feed)
     feed->link = GetWstr(kTorrent_Discovery_Source);
-  Aggregator.LoadArchive();
+  Aggregator.archive.Load();
 
   return result.status == pugi::status_ok;
 }
@@ -48,6 +48,10 @@ enum AppSettingName {
   kSync_Service_Mal_Password,
   kSync_Service_Hummingbird_Username,
   kSync_Service_Hummingbird_Password,
+  kSync_Service_Mal_RequestRate,
+  kSync_Service_Mal_RequestBurst,
+  kSync_Service_Hummingbird_RequestRate,
+  kSync_Service_Hummingbird_RequestBurst,
 
   // Library
   kLibrary_WatchFolders,
@@ -70,6 +74,8 @@ enum AppSettingName {
   kApp_Connection_ProxyHost,
   kApp_Connection_ProxyUsername,
   kApp_Connection_ProxyPassword,
+  kApp_Connection_IdleTimeout,
+  kApp_Connection_MaxPoolSize,
   kApp_Interface_Theme,
   kApp_Interface_ExternalLinks,
 
@@ -117,6 +123,7 @@ enum AppSettingName {
   kTorrent_Discovery_AutoCheckEnabled,
   kTorrent_Discovery_AutoCheckInterval,
   kTorrent_Discovery_NewAction,
+  kTorrent_Discovery_SaveCache,
   kTorrent_Download_AppMode,
   kTorrent_Download_AppPath,
   kTorrent_Download_Location,
@@ -125,6 +132,7 @@ enum AppSettingName {
   kTorrent_Download_CreateSubfolder,
   kTorrent_Filter_Enabled,
   kTorrent_Filter_ArchiveMaxCount,
+  kTorrent_Filter_ArchiveMaxAge,
 
   // Internal
   kApp_Position_X,
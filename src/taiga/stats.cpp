@@ -34,6 +34,8 @@ Statistics::Statistics()
       episode_count(0),
       image_count(0),
       image_size(0),
+      library_entries_changed(0),
+      library_entries_skipped(0),
       score_mean(0.0f),
       score_deviation(0.0f),
       score_count(11, 0),
@@ -123,7 +125,7 @@ const std::wstring& Statistics::CalculateLifeSpentWatching() {
 void Statistics::CalculateLocalData() {
   std::vector<std::wstring> file_list;
 
-  image_count = PopulateFiles(file_list, anime::GetImagePath());
+  image_count = PopulateFiles(file_list, anime::GetImagePath(), L"jpg");
   image_size = GetFolderSize(anime::GetImagePath(), false);
 
   file_list.clear();
@@ -45,6 +45,8 @@ public:
   int episode_count;
   int image_count;
   int image_size;
+  int library_entries_changed;
+  int library_entries_skipped;
   std::wstring life_spent_watching;
   float score_mean;
   float score_deviation;
@@ -21,6 +21,8 @@
 #include "base/string.h"
 #include "library/anime_db.h"
 #include "library/history.h"
+#include "library/resource.h"
+#include "sync/cache.h"
 #include "taiga/announce.h"
 #include "taiga/api.h"
 #include "taiga/dummy.h"
@@ -103,13 +105,15 @@ void App::Uninitialize() {
 
   // Cleanup
   ConnectionManager.Shutdown();
+  ImageDatabase.Shutdown();
   Taskbar.Destroy();
   TaskbarList.Release();
 
   // Save
   Settings.Save();
   AnimeDatabase.SaveDatabase();
-  Aggregator.SaveArchive();
+  Aggregator.archive.Save();
+  ResponseCache.Save();
 
   // Exit
   PostQuitMessage();
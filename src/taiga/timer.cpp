@@ -20,10 +20,11 @@
 #include "base/logger.h"
 #include "base/string.h"
 #include "library/anime.h"
+#include "library/anime_calendar.h"
 #include "library/anime_db.h"
 #include "library/anime_util.h"
 #include "library/history.h"
-#include "library/resource.h"
+#include "sync/manager.h"
 #include "taiga/announce.h"
 #include "taiga/http.h"
 #include "taiga/settings.h"
@@ -79,7 +80,6 @@ void Timer::OnTimeout() {
 
     case kTimerMemory:
       ConnectionManager.FreeMemory();
-      ImageDatabase.FreeMemory();
       break;
 
     case kTimerStats:
@@ -120,6 +120,10 @@ void TimerManager::UpdateIntervalsFromSettings() {
 }
 
 void TimerManager::OnTick() {
+  // Airing calendar
+  if (AiringCalendar.Update())
+    ui::DlgMain.UpdateTip();
+
   // Library
   timer_library.set_enabled(!Settings.GetBool(taiga::kLibrary_WatchFolders));
 
@@ -131,6 +135,9 @@ void TimerManager::OnTick() {
   timer_media.set_enabled(media_player_is_running && media_player_is_active &&
                           !episode_processed);
 
+  // Services
+  ServiceManager.ProcessQueue();
+
   // Statistics
   Stats.uptime++;
   timer_stats.set_enabled(ui::DlgStats.IsVisible() != FALSE);
@@ -17,6 +17,7 @@
 */
 
 #include <algorithm>
+#include <unordered_set>
 
 #include "base/encoding.h"
 #include "base/file.h"
@@ -24,6 +25,7 @@
 #include "base/logger.h"
 #include "base/string.h"
 #include "base/xml.h"
+#include "library/anime_calendar.h"
 #include "library/anime_db.h"
 #include "library/anime_util.h"
 #include "taiga/http.h"
@@ -81,16 +83,96 @@ bool FeedItem::operator<(const FeedItem& item) const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+FeedSource::FeedSource()
+    : feed(nullptr),
+      modified(false),
+      pending(false) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FeedDownload::FeedDownload()
+    : index(-1),
+      feed(nullptr),
+      pending(false),
+      success(false) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Feed::Feed()
     : category(kFeedCategoryLink),
-      download_index(-1) {
+      checking(false),
+      airing_generation_(0),
+      library_generation_(0),
+      recognition_generation_(0) {
 }
 
 bool Feed::Check(const std::wstring& source, bool automatic) {
-  if (source.empty())
+  std::vector<std::wstring> links, split_links;
+  Split(source, L"|", split_links);
+  foreach_(it, split_links) {
+    Trim(*it);
+    if (!it->empty())
+      links.push_back(*it);
+  }
+  if (links.empty())
     return false;
 
-  link = source;
+  std::vector<HttpRequest> http_requests;
+
+  {
+    win::Lock lock(Aggregator.critical_section);
+
+    // Wait for the previous check to complete. Checks that are requested by
+    // the user in the meantime are made afterwards, see
+    // Aggregator::CompleteFeedCheck.
+    if (checking) {
+      if (!automatic)
+        queued_source = source;
+      return false;
+    }
+    checking = true;
+
+    // Validators and items are kept for sources that were checked before
+    std::vector<FeedSource> new_sources(links.size());
+    for (size_t i = 0; i < links.size(); i++) {
+      new_sources[i].link = links[i];
+      foreach_(it, sources) {
+        if (it->link == links[i]) {
+          new_sources[i] = *it;
+          break;
+        }
+      }
+    }
+    sources.swap(new_sources);
+
+    link = links.front();
+
+    // Every source is marked as pending before the first request is made, so
+    // that the check cannot be completed early
+    foreach_(it, sources) {
+      it->feed = this;
+      it->modified = false;
+      it->pending = true;
+    }
+
+    foreach_(it, sources) {
+      win::http::Url url(it->link);
+
+      http_requests.push_back(HttpRequest());
+      HttpRequest& http_request = http_requests.back();
+      http_request.host = url.host;
+      http_request.path = url.path;
+      http_request.parameter = reinterpret_cast<LPARAM>(&(*it));
+
+      // Unchanged sources will return "304 Not Modified"
+      if (!it->etag.empty())
+        http_request.header[L"If-None-Match"] = it->etag;
+      if (!it->last_modified.empty())
+        http_request.header[L"If-Modified-Since"] = it->last_modified;
+    }
+  }
 
   switch (category) {
     case kFeedCategoryLink:
@@ -98,18 +180,15 @@ bool Feed::Check(const std::wstring& source, bool automatic) {
       break;
   }
 
-  win::http::Url url(link);
-
-  HttpRequest http_request;
-  http_request.host = url.host;
-  http_request.path = url.path;
-  http_request.parameter = reinterpret_cast<LPARAM>(this);
-
   auto client_mode = automatic ?
       taiga::kHttpFeedCheckAuto : taiga::kHttpFeedCheck;
-  auto& client = ConnectionManager.GetNewClient(http_request.uuid);
-  client.set_download_path(GetDataPath() + L"feed.xml");
-  ConnectionManager.MakeRequest(client, http_request, client_mode);
+
+  // The response is parsed directly from memory, see
+  // Aggregator::HandleFeedCheck
+  foreach_(it, http_requests) {
+    auto& client = ConnectionManager.GetNewClient(it->uuid);
+    ConnectionManager.MakeRequest(client, *it, client_mode);
+  }
 
   return true;
 }
@@ -118,47 +197,111 @@ bool Feed::Download(int index) {
   if (category != kFeedCategoryLink)
     return false;
 
-  auto client_mode = taiga::kHttpFeedDownload;
+  std::vector<int> indexes;
   if (index == -1) {
-    for (size_t i = 0; i < items.size(); i++) {
-      if (items.at(i).state == kFeedItemSelected) {
-        client_mode = taiga::kHttpFeedDownloadAll;
-        index = i;
-        break;
-      }
-    }
+    for (size_t i = 0; i < items.size(); i++)
+      if (items.at(i).state == kFeedItemSelected)
+        indexes.push_back(i);
+  } else if (index >= 0 && index < static_cast<int>(items.size())) {
+    indexes.push_back(index);
   }
-  if (index < 0 || index > static_cast<int>(items.size()))
+  if (indexes.empty())
     return false;
-  download_index = index;
 
-  ui::ChangeStatusText(L"Downloading \"" + items[index].title + L"\"...");
-  ui::EnableDialogInput(ui::kDialogTorrents, false);
+  auto client_mode = index == -1 ?
+      taiga::kHttpFeedDownloadAll : taiga::kHttpFeedDownload;
 
-  std::wstring file = items[index].title + L".torrent";
-  ValidateFileName(file);
-  file = GetDataPath() + file;
+  std::vector<HttpRequest> http_requests;
+
+  {
+    win::Lock lock(Aggregator.critical_section);
 
-  win::http::Url url(items[index].link);
+    // Wait for the previous downloads to complete
+    if (!downloads.empty())
+      return false;
 
-  HttpRequest http_request;
-  http_request.host = url.host;
-  http_request.path = url.path;
-  http_request.parameter = reinterpret_cast<LPARAM>(this);
+    // Every download is added before the first request is made, so that the
+    // batch cannot be completed early
+    for (size_t i = 0; i < indexes.size(); i++) {
+      const FeedItem& item = items.at(indexes[i]);
+      downloads.push_back(FeedDownload());
+      FeedDownload& download = downloads.back();
+      download.index = indexes[i];
+      download.link = item.link;
+      download.title = item.title;
+      download.feed = this;
+      download.pending = true;
+
+      // Each request is constructed separately to get its own ID
+      win::http::Url url(item.link);
+      http_requests.push_back(HttpRequest());
+      http_requests.back().host = url.host;
+      http_requests.back().path = url.path;
+      http_requests.back().parameter = reinterpret_cast<LPARAM>(&download);
+    }
+  }
 
-  auto& client = ConnectionManager.GetNewClient(http_request.uuid);
-  client.set_download_path(file);
-  ConnectionManager.MakeRequest(client, http_request, client_mode);
+  if (indexes.size() == 1) {
+    ui::ChangeStatusText(L"Downloading \"" + items[indexes.front()].title +
+                         L"\"...");
+  } else {
+    ui::ChangeStatusText(L"Downloading " + ToWstr(static_cast<int>(indexes.size())) +
+                         L" torrents...");
+  }
+  ui::EnableDialogInput(ui::kDialogTorrents, false);
+
+  // Requests are queued by the connection manager, which limits the number of
+  // simultaneous connections to each host. Files are saved when a download is
+  // complete, see Aggregator::HandleFeedDownload.
+  foreach_(it, http_requests) {
+    auto& client = ConnectionManager.GetNewClient(it->uuid);
+    ConnectionManager.MakeRequest(client, *it, client_mode);
+  }
 
   return true;
 }
 
-bool Feed::ExamineData() {
+static std::wstring GetExaminationKey(const FeedItem& item) {
+  std::wstring key = !item.guid.empty() ? item.guid : item.link;
+
+  // Examination results depend on the title alone, so we make sure that the
+  // title has not changed for the same item.
+  key += L'\0' + item.title;
+
+  return key;
+}
+
+void Feed::ValidateExaminationCache() {
+  unsigned int airing_generation = AiringCalendar.generation();
+  unsigned int library_generation = AnimeDatabase.generation();
+  unsigned int recognition_generation = Meow.generation();
+
+  if (airing_generation != airing_generation_ ||
+      library_generation != library_generation_ ||
+      recognition_generation != recognition_generation_) {
+    examined_items_.clear();
+  }
+}
+
+void Feed::Examine() {
+  ValidateExaminationCache();
+
+  std::unordered_map<std::wstring, anime::Episode> examined_items;
+
   foreach_(it, items) {
-    // Examine title and compare with anime list items
-    Meow.ExamineTitle(it->title, it->episode_data,
-                      true, true, true, true, false);
-    Meow.MatchDatabase(it->episode_data, true, true);
+    std::wstring key = GetExaminationKey(*it);
+    anime::Episode& episode = it->episode_data;
+
+    auto examined_item = examined_items_.find(key);
+    if (examined_item != examined_items_.end()) {
+      episode = examined_item->second;
+    } else {
+      // Examine title and compare with anime list items
+      Meow.ExamineTitle(it->title, it->episode_data,
+                        true, true, true, true, false);
+      Meow.MatchDatabase(it->episode_data, true, true);
+    }
+    examined_items[key] = episode;
 
     // Update last aired episode number
     if (it->episode_data.anime_id > anime::ID_UNKNOWN) {
@@ -168,6 +311,17 @@ bool Feed::ExamineData() {
     }
   }
 
+  // Only the items that are still in the feed are kept. Generations are
+  // updated after examination, as matching may update clean titles.
+  examined_items_.swap(examined_items);
+  airing_generation_ = AiringCalendar.generation();
+  library_generation_ = AnimeDatabase.generation();
+  recognition_generation_ = Meow.generation();
+}
+
+bool Feed::ExamineData() {
+  Examine();
+
   Aggregator.filter_manager.MarkNewEpisodes(*this);
   // Preferences have lower priority, so we need to handle other filters
   // first in order to avoid discarding items that we actually want.
@@ -196,6 +350,42 @@ std::wstring Feed::GetDataPath() {
   return path;
 }
 
+static bool ReadFeedDocument(Feed& feed, const xml_document& document);
+
+// Items are identified by their info hash if available, or by their titles
+static std::wstring GetMergeKey(const FeedItem& item) {
+  const std::wstring& link = !item.magnet_link.empty() ?
+      item.magnet_link : item.link;
+
+  int pos = InStr(link, L"urn:btih:", 0, true);
+  if (pos > -1) {
+    pos += 9;
+    size_t end = link.find(L'&', pos);
+    if (end == std::wstring::npos)
+      end = link.length();
+    return L"h" + ToLower_Copy(link.substr(pos, end - pos));
+  }
+
+  std::wstring title = item.title;
+  Trim(title);
+  return L"t" + ToLower_Copy(title);
+}
+
+void Feed::MergeSources() {
+  items.clear();
+
+  // Earlier sources have priority over later ones
+  std::unordered_set<std::wstring> keys;
+  foreach_(source, sources) {
+    foreach_c_(it, source->items) {
+      if (keys.insert(GetMergeKey(*it)).second) {
+        items.push_back(*it);
+        items.back().index = items.size() - 1;
+      }
+    }
+  }
+}
+
 bool Feed::Load() {
   std::wstring file = GetDataPath() + L"feed.xml";
   items.clear();
@@ -206,11 +396,35 @@ bool Feed::Load() {
   if (parse_result.status != pugi::status_ok)
     return false;
 
+  return ReadFeedDocument(*this, document);
+}
+
+bool Feed::Load(const std::string& data) {
+  items.clear();
+
+  if (data.empty())
+    return false;
+
+  // pugixml detects the encoding of the raw response and converts the text
+  // while parsing, so there is no need for an intermediate copy.
+  xml_document document;
+  xml_parse_result parse_result = document.load_buffer(data.data(),
+                                                       data.size());
+
+  if (parse_result.status != pugi::status_ok)
+    return false;
+
+  return ReadFeedDocument(*this, document);
+}
+
+static bool ReadFeedDocument(Feed& feed, const xml_document& document) {
+  auto& items = feed.items;
+
   // Read channel information
   xml_node channel = document.child(L"rss").child(L"channel");
-  title = XmlReadStrValue(channel, L"title");
-  link = XmlReadStrValue(channel, L"link");
-  description = XmlReadStrValue(channel, L"description");
+  feed.title = XmlReadStrValue(channel, L"title");
+  feed.link = XmlReadStrValue(channel, L"link");
+  feed.description = XmlReadStrValue(channel, L"description");
 
   // Read items
   foreach_xmlnode_(item, channel, L"item") {
@@ -220,10 +434,11 @@ bool Feed::Load() {
     items.back().category = XmlReadStrValue(item, L"category");
     items.back().title = XmlReadStrValue(item, L"title");
     items.back().link = XmlReadStrValue(item, L"link");
+    items.back().guid = XmlReadStrValue(item, L"guid");
     items.back().description = XmlReadStrValue(item, L"description");
     
     // Remove if title or link is empty
-    if (category == kFeedCategoryLink) {
+    if (feed.category == kFeedCategoryLink) {
       if (items.back().title.empty() || items.back().link.empty()) {
         items.pop_back();
         continue;
@@ -239,7 +454,7 @@ bool Feed::Load() {
     StripHtmlTags(items.back().description);
     DecodeHtmlEntities(items.back().description);
     Trim(items.back().description, L" \n");
-    Aggregator.ParseDescription(items.back(), link);
+    Aggregator.ParseDescription(items.back(), feed.link);
     Replace(items.back().description, L"\n", L" | ");
   }
 
@@ -248,6 +463,192 @@ bool Feed::Load() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// The archive is saved as a list of entries sorted by title, preceded by
+// a small header:
+//
+//   char[4]  signature ("TFA1")
+//   uint32   number of entries
+//
+// Each entry consists of:
+//
+//   int64    time of addition
+//   uint32   length of the title in bytes
+//   char[]   title, UTF-8 encoded
+
+static const char kFeedArchiveSignature[] = {'T', 'F', 'A', '1'};
+
+static std::wstring NormalizeArchiveTitle(const std::wstring& title) {
+  std::wstring normal_title = title;
+  Trim(normal_title, L" \t\r\n");
+  ToLower(normal_title);
+  return normal_title;
+}
+
+template <typename T>
+static void WriteArchiveValue(std::string& output, const T& value) {
+  output.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool ReadArchiveValue(const std::string& input, size_t& pos, T& value) {
+  if (pos + sizeof(T) > input.size())
+    return false;
+  memcpy(&value, input.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+void FeedArchive::Add(const std::wstring& title) {
+  win::Lock lock(critical_section_);
+
+  items_[NormalizeArchiveTitle(title)] = time(nullptr);
+
+  // Leave some room, so that we don't have to trim after each addition
+  size_t max_count = Settings.GetInt(taiga::kTorrent_Filter_ArchiveMaxCount);
+  if (max_count > 0 && items_.size() > max_count + max_count / 10)
+    Trim(max_count, 0);
+}
+
+void FeedArchive::Clear() {
+  win::Lock lock(critical_section_);
+
+  items_.clear();
+}
+
+bool FeedArchive::Contains(const std::wstring& title) const {
+  win::Lock lock(critical_section_);
+
+  return items_.find(NormalizeArchiveTitle(title)) != items_.end();
+}
+
+size_t FeedArchive::size() const {
+  win::Lock lock(critical_section_);
+
+  return items_.size();
+}
+
+bool FeedArchive::Load() {
+  win::Lock lock(critical_section_);
+
+  items_.clear();
+
+  std::string input;
+  std::wstring path = taiga::GetPath(taiga::kPathFeedArchive);
+  if (!ReadFromFile(path, input))
+    return LoadLegacy();
+
+  size_t pos = 0;
+  char signature[sizeof(kFeedArchiveSignature)];
+  UINT32 count = 0;
+  if (!ReadArchiveValue(input, pos, signature) ||
+      memcmp(signature, kFeedArchiveSignature, sizeof(signature)) != 0 ||
+      !ReadArchiveValue(input, pos, count)) {
+    LOG(LevelWarning, L"Invalid archive file: " + path);
+    return false;
+  }
+
+  items_.rehash(count);
+
+  for (UINT32 i = 0; i < count; i++) {
+    INT64 added = 0;
+    UINT32 length = 0;
+    if (!ReadArchiveValue(input, pos, added) ||
+        !ReadArchiveValue(input, pos, length) ||
+        pos + length > input.size()) {
+      LOG(LevelWarning, L"Archive file is truncated: " + path);
+      break;
+    }
+    std::string title(input, pos, length);
+    pos += length;
+    items_[StrToWstr(title)] = static_cast<time_t>(added);
+  }
+
+  return true;
+}
+
+// Older versions kept the archive as an XML file, in order of addition
+bool FeedArchive::LoadLegacy() {
+  xml_document document;
+  std::wstring path = taiga::GetPath(taiga::kPathFeedHistory);
+  xml_parse_result parse_result = document.load_file(path.c_str());
+
+  if (parse_result.status != pugi::status_ok)
+    return false;
+
+  std::vector<std::wstring> titles;
+  xml_node archive_node = document.child(L"archive");
+  foreach_xmlnode_(node, archive_node, L"item")
+    titles.push_back(node.attribute(L"title").value());
+
+  // Spread the entries over the past few seconds to preserve their order
+  time_t now = time(nullptr);
+  for (size_t i = 0; i < titles.size(); i++)
+    items_[NormalizeArchiveTitle(titles[i])] = now - (titles.size() - i);
+
+  return true;
+}
+
+bool FeedArchive::Save() {
+  win::Lock lock(critical_section_);
+
+  size_t max_count = Settings.GetInt(taiga::kTorrent_Filter_ArchiveMaxCount);
+  time_t max_age = Settings.GetInt(taiga::kTorrent_Filter_ArchiveMaxAge) *
+                   60 * 60 * 24;  // days
+  Trim(max_count, max_age);
+
+  std::vector<std::pair<std::string, time_t>> entries;
+  entries.reserve(items_.size());
+  foreach_(it, items_)
+    entries.push_back(std::make_pair(WstrToStr(it->first), it->second));
+  std::sort(entries.begin(), entries.end());
+
+  std::string output;
+  output.append(kFeedArchiveSignature, sizeof(kFeedArchiveSignature));
+  WriteArchiveValue(output, static_cast<UINT32>(entries.size()));
+  foreach_(it, entries) {
+    WriteArchiveValue(output, static_cast<INT64>(it->second));
+    WriteArchiveValue(output, static_cast<UINT32>(it->first.size()));
+    output.append(it->first);
+  }
+
+  std::wstring path = taiga::GetPath(taiga::kPathFeedArchive);
+  return SaveToFile((LPCVOID)output.data(), output.size(), path);
+}
+
+void FeedArchive::Trim(size_t max_count, time_t max_age) {
+  // A maximum count of zero means that we don't keep an archive at all
+  if (max_count == 0) {
+    items_.clear();
+    return;
+  }
+
+  if (max_age > 0) {
+    time_t min_time = time(nullptr) - max_age;
+    for (auto it = items_.begin(); it != items_.end(); ) {
+      if (it->second < min_time) {
+        it = items_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  if (items_.size() > max_count) {
+    std::vector<std::pair<time_t, std::wstring>> entries;
+    entries.reserve(items_.size());
+    foreach_(it, items_)
+      entries.push_back(std::make_pair(it->second, it->first));
+    // Move the oldest entries to the front. Entries that were added at the
+    // same second are ordered by title, so that exactly max_count are kept.
+    auto nth = entries.end() - max_count;
+    std::nth_element(entries.begin(), nth, entries.end());
+    for (auto it = entries.begin(); it != nth; ++it)
+      items_.erase(it->second);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Aggregator::Aggregator() {
   // Add torrent feed
   feeds.resize(feeds.size() + 1);
@@ -266,112 +667,232 @@ bool Aggregator::Notify(const Feed& feed) {
   return ui::OnFeedNotify(feed);
 }
 
-bool Aggregator::SearchArchive(const std::wstring& file) {
-  foreach_(it, file_archive)
-    if (*it == file)
-      return true;
+void Aggregator::HandleFeedCheck(FeedSource& source,
+                                 const HttpResponse& response,
+                                 const std::string& data,
+                                 bool automatic) {
+  Feed source_feed;
+  source_feed.category = source.feed->category;
+  source_feed.link = source.link;
+  std::wstring cache_path = source_feed.GetDataPath() + L"feed.xml";
+
+  // A "304 Not Modified" response means that we can keep the items from the
+  // previous check
+  if (response.code != 304) {
+    source_feed.Load(data);
+
+    win::Lock lock(critical_section);
+    source.items.swap(source_feed.items);
+    source.etag.clear();
+    source.last_modified.clear();
+    foreach_(it, response.header) {
+      if (IsEqual(it->first, L"ETag")) {
+        source.etag = it->second;
+      } else if (IsEqual(it->first, L"Last-Modified")) {
+        source.last_modified = it->second;
+      }
+    }
+    source.modified = true;
+  }
 
-  return false;
+  CompleteFeedCheck(source, automatic);
+
+  // The cache is not needed for anything else, so we write it only after the
+  // items are handled, still on the worker thread of the connection.
+  if (Settings.GetBool(taiga::kTorrent_Discovery_SaveCache) && !data.empty())
+    SaveToFile((LPCVOID)&data.front(), data.size(), cache_path);
 }
 
-void Aggregator::HandleFeedCheck(Feed& feed, bool automatic) {
-  feed.Load();
+void Aggregator::HandleFeedCheckError(FeedSource& source, bool automatic) {
+  // Items from the previous check are kept for the failed source
+  CompleteFeedCheck(source, automatic);
+}
 
-  bool success = feed.ExamineData();
-  ui::OnFeedCheck(success);
+void Aggregator::CompleteFeedCheck(FeedSource& source, bool automatic) {
+  Feed& feed = *source.feed;
+  bool modified = false;
+
+  {
+    win::Lock lock(critical_section);
+    source.pending = false;
+    foreach_(it, feed.sources) {
+      if (it->pending)
+        return;  // Wait for other sources
+      if (it->modified)
+        modified = true;
+    }
+  }
 
-  if (automatic) {
-    switch (Settings.GetInt(taiga::kTorrent_Discovery_NewAction)) {
-      case 1:  // Notify
-        Notify(feed);
-        break;
-      case 2:  // Download
-        feed.Download(-1);
-        break;
+  // Only the thread of the last source gets here, and the feed is not checked
+  // again until we are done.
+  if (modified) {
+    feed.MergeSources();
+    bool success = feed.ExamineData();
+    ui::OnFeedCheck(success);
+
+    if (automatic) {
+      switch (Settings.GetInt(taiga::kTorrent_Discovery_NewAction)) {
+        case 1:  // Notify
+          Notify(feed);
+          break;
+        case 2:  // Download
+          feed.Download(-1);
+          break;
+      }
     }
+  } else {
+    // Nothing has changed since the previous check
+    ui::OnFeedCheck(filter_manager.IsItemDownloadAvailable(feed));
   }
-}
 
-void Aggregator::HandleFeedDownload(Feed& feed, bool download_all) {
-  auto feed_item = reinterpret_cast<FeedItem*>(&feed.items.at(feed.download_index));
+  std::wstring queued_source;
 
-  file_archive.push_back(feed_item->title);
+  {
+    win::Lock lock(critical_section);
+    feed.checking = false;
+    queued_source.swap(feed.queued_source);
+  }
 
-  std::wstring file = feed_item->title;
-  ValidateFileName(file);
-  file = feed.GetDataPath() + file + L".torrent";
-
-  if (FileExists(file)) {
-    std::wstring app_path;
-    std::wstring parameters;
-
-    switch (Settings.GetInt(taiga::kTorrent_Download_AppMode)) {
-      case 1:  // Default application
-        app_path = GetDefaultAppPath(L".torrent", L"");
-        break;
-      case 2:  // Custom application
-        app_path = Settings[taiga::kTorrent_Download_AppPath];
-        break;
-    }
+  // Make the check that was requested by the user while this one was running
+  if (!queued_source.empty())
+    feed.Check(queued_source);
+}
 
-    if (Settings.GetBool(taiga::kTorrent_Download_UseAnimeFolder) &&
-        InStr(app_path, L"utorrent", 0, true) > -1) {
-      std::wstring download_path;
-      // Use anime folder as the download folder
-      auto anime_id = feed_item->episode_data.anime_id;
-      auto anime_item = AnimeDatabase.FindItem(anime_id);
-      if (anime_item) {
-        std::wstring anime_folder = anime_item->GetFolder();
-        if (!anime_folder.empty() && FolderExists(anime_folder))
-          download_path = anime_folder;
-      }
-      // If no anime folder is set, use an alternative folder
-      if (download_path.empty()) {
-        if (Settings.GetBool(taiga::kTorrent_Download_FallbackOnFolder) &&
-            !Settings[taiga::kTorrent_Download_Location].empty()) {
-          download_path = Settings[taiga::kTorrent_Download_Location];
-        }
-        // Create a subfolder using the anime title as its name
-        if (!download_path.empty() &&
-            Settings.GetBool(taiga::kTorrent_Download_CreateSubfolder)) {
-          std::wstring anime_title;
-          if (anime_item) {
-            anime_title = anime_item->GetTitle();
-          } else {
-            anime_title = feed_item->episode_data.title;
-          }
-          ValidateFileName(anime_title);
-          TrimRight(anime_title, L".");
-          AddTrailingSlash(download_path);
-          download_path += anime_title;
-          if (!CreateFolder(download_path))
-            LOG(LevelWarning, L"Subfolder could not be created.");
-          if (anime_item) {
-            anime_item->SetFolder(download_path);
-            Settings.Save();
+void Aggregator::HandleFeedDownload(FeedDownload& download,
+                                    const HttpResponse& response,
+                                    const std::string& data) {
+  std::wstring file = download.title;
+  ValidateFileName(file);
+  file = download.feed->GetDataPath() + file + L".torrent";
+
+  // Error pages are not saved as torrent files
+  bool success = response.code == 200 && !data.empty() &&
+                 SaveToFileAtomic((LPCVOID)&data.front(), data.size(), file);
+
+  if (success) {
+    archive.Add(download.title);
+
+    anime::Episode episode;
+    {
+      win::Lock lock(critical_section);
+      Feed& feed = *download.feed;
+      FeedItem* feed_item = nullptr;
+      if (download.index < static_cast<int>(feed.items.size()) &&
+          feed.items.at(download.index).link == download.link) {
+        feed_item = &feed.items.at(download.index);
+      } else {
+        foreach_(it, feed.items) {
+          if (it->link == download.link) {
+            feed_item = &(*it);
+            break;
           }
         }
       }
+      if (feed_item) {
+        episode = feed_item->episode_data;
+        feed_item->state = kFeedItemDiscardedNormal;
+      }
+    }
+
+    OpenTorrentFile(file, episode);
+  } else {
+    LOG(LevelWarning, L"Could not download torrent file: " + download.link);
+  }
 
-      // Set the command line parameter
-      if (!download_path.empty())
-        parameters = L"/directory \"" + download_path + L"\" ";
+  CompleteFeedDownload(download, success);
+}
+
+void Aggregator::HandleFeedDownloadError(FeedDownload& download) {
+  CompleteFeedDownload(download, false);
+}
+
+void Aggregator::CompleteFeedDownload(FeedDownload& download, bool success) {
+  Feed& feed = *download.feed;
+  int succeeded = 0;
+  int failed = 0;
+
+  {
+    win::Lock lock(critical_section);
+    download.pending = false;
+    download.success = success;
+    foreach_(it, feed.downloads) {
+      if (it->pending)
+        return;  // Wait for other downloads
+      if (it->success) {
+        succeeded++;
+      } else {
+        failed++;
+      }
     }
+    // Only the thread of the last download gets here
+    feed.downloads.clear();
+  }
 
-    parameters += L"\"" + file + L"\"";
-    Execute(app_path, parameters);
+  ui::OnFeedDownload(succeeded, failed);
+}
 
-    feed_item->state = kFeedItemDiscardedNormal;
-    ui::OnFeedDownload(true);
+void Aggregator::OpenTorrentFile(const std::wstring& file,
+                                 const anime::Episode& episode) {
+  win::Lock lock(open_critical_section_);
+
+  std::wstring app_path;
+  std::wstring parameters;
+
+  switch (Settings.GetInt(taiga::kTorrent_Download_AppMode)) {
+    case 1:  // Default application
+      app_path = GetDefaultAppPath(L".torrent", L"");
+      break;
+    case 2:  // Custom application
+      app_path = Settings[taiga::kTorrent_Download_AppPath];
+      break;
   }
 
-  feed.download_index = -1;
+  if (Settings.GetBool(taiga::kTorrent_Download_UseAnimeFolder) &&
+      InStr(app_path, L"utorrent", 0, true) > -1) {
+    std::wstring download_path;
+    // Use anime folder as the download folder
+    auto anime_id = episode.anime_id;
+    auto anime_item = AnimeDatabase.FindItem(anime_id);
+    if (anime_item) {
+      std::wstring anime_folder = anime_item->GetFolder();
+      if (!anime_folder.empty() && FolderExists(anime_folder))
+        download_path = anime_folder;
+    }
+    // If no anime folder is set, use an alternative folder
+    if (download_path.empty()) {
+      if (Settings.GetBool(taiga::kTorrent_Download_FallbackOnFolder) &&
+          !Settings[taiga::kTorrent_Download_Location].empty()) {
+        download_path = Settings[taiga::kTorrent_Download_Location];
+      }
+      // Create a subfolder using the anime title as its name
+      if (!download_path.empty() &&
+          Settings.GetBool(taiga::kTorrent_Download_CreateSubfolder)) {
+        std::wstring anime_title;
+        if (anime_item) {
+          anime_title = anime_item->GetTitle();
+        } else {
+          anime_title = episode.title;
+        }
+        ValidateFileName(anime_title);
+        TrimRight(anime_title, L".");
+        AddTrailingSlash(download_path);
+        download_path += anime_title;
+        if (!CreateFolder(download_path))
+          LOG(LevelWarning, L"Subfolder could not be created.");
+        if (anime_item) {
+          anime_item->SetFolder(download_path);
+          Settings.Save();
+        }
+      }
+    }
 
-  if (download_all)
-    if (feed.Download(-1))
-      return;
+    // Set the command line parameter
+    if (!download_path.empty())
+      parameters = L"/directory \"" + download_path + L"\" ";
+  }
 
-  ui::OnFeedDownload(false);
+  parameters += L"\"" + file + L"\"";
+  Execute(app_path, parameters);
 }
 
 void Aggregator::ParseDescription(FeedItem& feed_item,
@@ -434,45 +955,6 @@ void Aggregator::ParseDescription(FeedItem& feed_item,
   }
 }
 
-bool Aggregator::LoadArchive() {
-  xml_document document;
-  std::wstring path = taiga::GetPath(taiga::kPathFeedHistory);
-  xml_parse_result parse_result = document.load_file(path.c_str());
-
-  if (parse_result.status != pugi::status_ok)
-    return false;
-
-  // Read discarded
-  file_archive.clear();
-  xml_node archive_node = document.child(L"archive");
-  foreach_xmlnode_(node, archive_node, L"item") {
-    file_archive.push_back(node.attribute(L"title").value());
-  }
-
-  return true;
-}
-
-bool Aggregator::SaveArchive() {
-  xml_document document;
-  xml_node archive_node = document.append_child(L"archive");
-
-  size_t max_count = Settings.GetInt(taiga::kTorrent_Filter_ArchiveMaxCount);
-
-  if (max_count > 0) {
-    size_t length = file_archive.size();
-    size_t i = 0;
-    if (length > max_count)
-      i = length - max_count;
-    for ( ; i < file_archive.size(); i++) {
-      xml_node xml_item = archive_node.append_child(L"item");
-      xml_item.append_attribute(L"title") = file_archive[i].c_str();
-    }
-  }
-
-  std::wstring path = taiga::GetPath(taiga::kPathFeedHistory);
-  return XmlWriteDocumentToFile(document, path);
-}
-
 bool Aggregator::CompareFeedItems(const GenericFeedItem& item1,
                                   const GenericFeedItem& item2) {
   // Check for guid element first
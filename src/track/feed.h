@@ -19,11 +19,16 @@
 #ifndef TAIGA_TRACK_FEED_H
 #define TAIGA_TRACK_FEED_H
 
+#include <ctime>
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "base/types.h"
 #include "library/anime_episode.h"
 #include "track/feed_filter.h"
+#include "win/win_thread.h"
 
 enum FeedItemState {
   kFeedItemBlank,
@@ -82,6 +87,7 @@ public:
   int index;
   std::wstring magnet_link;
   FeedItemState state;
+  FeedItemFeatures features;
 
   class EpisodeData : public anime::Episode {
   public:
@@ -107,19 +113,105 @@ public:
   std::vector<FeedItem> items;
 };
 
+class Feed;
+
+// A feed can be made up of several sources, which are checked concurrently.
+// Each source keeps its items and validators from the previous check, so that
+// unchanged sources can be skipped.
+
+class FeedSource {
+public:
+  FeedSource();
+  ~FeedSource() {}
+
+  std::wstring link;
+  std::wstring etag;
+  std::wstring last_modified;
+  std::vector<FeedItem> items;
+
+  Feed* feed;
+  bool modified;
+  bool pending;
+};
+
+// Torrent files of selected items are downloaded concurrently. Each download
+// refers to its own item, which is found by its link when the download is
+// complete, because the items may have been replaced by another check.
+
+class FeedDownload {
+public:
+  FeedDownload();
+  ~FeedDownload() {}
+
+  int index;
+  std::wstring link;
+  std::wstring title;
+
+  Feed* feed;
+  bool pending;
+  bool success;
+};
+
 class Feed : public GenericFeed {
 public:
   Feed();
   ~Feed() {}
 
+  // Multiple sources can be separated with "|". If a check is in progress,
+  // checks that are not automatic are queued to be made after it.
   bool Check(const std::wstring& source, bool automatic = false);
+  // All selected items are downloaded if the index is -1
   bool Download(int index);
+  void Examine();
   bool ExamineData();
   std::wstring GetDataPath();
   bool Load();
+  bool Load(const std::string& data);
+  void MergeSources();
 
   FeedCategory category;
-  int download_index;
+  bool checking;
+  std::wstring queued_source;
+  std::list<FeedDownload> downloads;
+  std::vector<FeedSource> sources;
+
+private:
+  void ValidateExaminationCache();
+
+  // Items that were seen in previous checks are not examined again, unless
+  // the library or the recognition engine has changed since.
+  std::unordered_map<std::wstring, anime::Episode> examined_items_;
+  unsigned int airing_generation_;
+  unsigned int library_generation_;
+  unsigned int recognition_generation_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Keeps the titles of torrents that were downloaded or discarded before, so
+// that they can be filtered out of later feed checks. Entries expire when the
+// archive exceeds its maximum size, or when they get older than the maximum
+// age, if one is set.
+
+class FeedArchive {
+public:
+  FeedArchive() {}
+  ~FeedArchive() {}
+
+  void Add(const std::wstring& title);
+  void Clear();
+  bool Contains(const std::wstring& title) const;
+  size_t size() const;
+
+  bool Load();
+  bool Save();
+
+private:
+  bool LoadLegacy();
+  void Trim(size_t max_count, time_t max_age);
+
+  std::unordered_map<std::wstring, time_t> items_;
+  mutable win::CriticalSection critical_section_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -131,21 +223,32 @@ public:
 
   Feed* Get(FeedCategory category);
 
-  void HandleFeedCheck(Feed& feed, bool automatic);
-  void HandleFeedDownload(Feed& feed, bool download_all);
+  void HandleFeedCheck(FeedSource& source, const HttpResponse& response,
+                       const std::string& data, bool automatic);
+  void HandleFeedCheckError(FeedSource& source, bool automatic);
+  void HandleFeedDownload(FeedDownload& download, const HttpResponse& response,
+                          const std::string& data);
+  void HandleFeedDownloadError(FeedDownload& download);
 
   bool Notify(const Feed& feed);
   void ParseDescription(FeedItem& feed_item, const std::wstring& source);
 
-  bool LoadArchive();
-  bool SaveArchive();
-  bool SearchArchive(const std::wstring& file);
-
+  FeedArchive archive;
   std::vector<Feed> feeds;
-  std::vector<std::wstring> file_archive;
   FeedFilterManager filter_manager;
 
+  // Guards feed sources and downloads, which are handled on connection
+  // threads
+  win::CriticalSection critical_section;
+
 private:
+  void CompleteFeedCheck(FeedSource& source, bool automatic);
+  void CompleteFeedDownload(FeedDownload& download, bool success);
+  void OpenTorrentFile(const std::wstring& file, const anime::Episode& episode);
+
+  // Torrent files are opened one at a time, even though they are downloaded
+  // concurrently
+  win::CriticalSection open_critical_section_;
   bool CompareFeedItems(const GenericFeedItem& item1, const GenericFeedItem& item2);
 };
 
@@ -16,6 +16,8 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "base/foreach.h"
 #include "base/logger.h"
 #include "base/string.h"
@@ -27,167 +29,328 @@
 #include "track/feed.h"
 #include "track/feed_filter.h"
 
-bool EvaluateCondition(const FeedFilterCondition& condition,
-                       const FeedItem& item) {
-  bool is_numeric = false;
-  std::wstring element;
-  std::wstring value = ReplaceVariables(condition.value, item.episode_data);
-  auto anime = AnimeDatabase.FindItem(item.episode_data.anime_id);
+// Returns false if the element is not numeric
+static bool GetNumericElement(FeedFilterElement element, const FeedItem& item,
+                              int& number) {
+  const FeedItemFeatures& features = item.features;
+  auto anime = features.anime;
 
-  switch (condition.element) {
+  switch (element) {
+    case kFeedFilterElement_Meta_Id:
+      number = anime ? anime->GetId() : 0;
+      return true;
+    case kFeedFilterElement_Meta_Episodes:
+      number = anime ? anime->GetEpisodeCount() : 0;
+      return true;
+    case kFeedFilterElement_Meta_Status:
+      number = anime ? anime->GetAiringStatus() : 0;
+      return true;
+    case kFeedFilterElement_Meta_Type:
+      number = anime ? anime->GetType() : 0;
+      return true;
+    case kFeedFilterElement_User_Status:
+      number = anime ? anime->GetMyStatus() : 0;
+      return true;
+    case kFeedFilterElement_Episode_Number:
+      number = features.episode_number;
+      return true;
+    case kFeedFilterElement_Episode_Version:
+      number = features.episode_version;
+      return true;
+    case kFeedFilterElement_Local_EpisodeAvailable:
+      number = features.episode_available;
+      return true;
+  }
+
+  return false;
+}
+
+// Most elements refer to existing strings. The buffer is only used for the
+// few elements that need to be converted.
+static const std::wstring& GetElementText(FeedFilterElement element,
+                                          const FeedItem& item,
+                                          std::wstring& buffer) {
+  auto anime = item.features.anime;
+
+  switch (element) {
     case kFeedFilterElement_File_Title:
-      element = item.title;
-      break;
+      return item.title;
     case kFeedFilterElement_File_Category:
-      element = item.category;
-      break;
+      return item.category;
     case kFeedFilterElement_File_Description:
-      element = item.description;
-      break;
+      return item.description;
     case kFeedFilterElement_File_Link:
-      element = item.link;
-      break;
-    case kFeedFilterElement_Meta_Id:
-      if (anime)
-        element = ToWstr(anime->GetId());
-      is_numeric = true;
-      break;
+      return item.link;
     case kFeedFilterElement_Episode_Title:
-      element = item.episode_data.title;
-      break;
+      return item.episode_data.title;
+    case kFeedFilterElement_Episode_Group:
+      return item.episode_data.group;
+    case kFeedFilterElement_Episode_VideoResolution:
+      return item.episode_data.resolution;
+    case kFeedFilterElement_Episode_VideoType:
+      return item.episode_data.video_type;
     case kFeedFilterElement_Meta_DateStart:
       if (anime)
-        element = anime->GetDateStart();
+        buffer = anime->GetDateStart();
       break;
     case kFeedFilterElement_Meta_DateEnd:
       if (anime)
-        element = anime->GetDateEnd();
-      break;
-    case kFeedFilterElement_Meta_Episodes:
-      if (anime)
-        element = ToWstr(anime->GetEpisodeCount());
-      is_numeric = true;
-      break;
-    case kFeedFilterElement_Meta_Status:
-      if (anime)
-        element = ToWstr(anime->GetAiringStatus());
-      is_numeric = true;
-      break;
-    case kFeedFilterElement_Meta_Type:
-      if (anime)
-        element = ToWstr(anime->GetType());
-      is_numeric = true;
-      break;
-    case kFeedFilterElement_User_Status:
-      if (anime)
-        element = ToWstr(anime->GetMyStatus());
-      is_numeric = true;
-      break;
-    case kFeedFilterElement_Episode_Number:
-      element = ToWstr(anime::GetEpisodeHigh(item.episode_data.number));
-      is_numeric = true;
+        buffer = anime->GetDateEnd();
       break;
     case kFeedFilterElement_Episode_Version:
-      element = item.episode_data.version;
-      if (element.empty())
-        element = L"1";
-      is_numeric = true;
+      if (!item.episode_data.version.empty())
+        return item.episode_data.version;
+      buffer = L"1";
       break;
-    case kFeedFilterElement_Local_EpisodeAvailable:
-      if (anime)
-        element = ToWstr(anime->IsEpisodeAvailable(
-            anime::GetEpisodeHigh(item.episode_data.number)));
-      is_numeric = true;
-      break;
-    case kFeedFilterElement_Episode_Group:
-      element = item.episode_data.group;
-      break;
-    case kFeedFilterElement_Episode_VideoResolution:
-      element = item.episode_data.resolution;
-      break;
-    case kFeedFilterElement_Episode_VideoType:
-      element = item.episode_data.video_type;
+    default: {
+      int number = 0;
+      if (GetNumericElement(element, item, number))
+        if (anime || element == kFeedFilterElement_Episode_Number)
+          buffer = ToWstr(number);
       break;
+    }
   }
 
-  switch (condition.op) {
+  return buffer;
+}
+
+static bool CompareNumbers(FeedFilterOperator op, int element, int value) {
+  switch (op) {
     case kFeedFilterOperator_Equals:
-      if (is_numeric) {
-        if (IsEqual(value, L"True"))
-          return ToInt(element) == TRUE;
-        return ToInt(element) == ToInt(value);
-      } else {
-        if (condition.element == kFeedFilterElement_Episode_VideoResolution) {
-          return anime::TranslateResolution(element) == anime::TranslateResolution(condition.value);
-        } else {
-          return IsEqual(element, value);
-        }
-      }
+      return element == value;
     case kFeedFilterOperator_NotEquals:
-      if (is_numeric) {
-        if (IsEqual(value, L"True"))
-          return ToInt(element) == TRUE;
-        return ToInt(element) != ToInt(value);
-      } else {
-        if (condition.element == kFeedFilterElement_Episode_VideoResolution) {
-          return anime::TranslateResolution(element) != anime::TranslateResolution(condition.value);
-        } else {
-          return !IsEqual(element, value);
-        }
-      }
+      return element != value;
     case kFeedFilterOperator_IsGreaterThan:
-      if (is_numeric) {
-        return ToInt(element) > ToInt(value);
-      } else {
-        if (condition.element == kFeedFilterElement_Episode_VideoResolution) {
-          return anime::TranslateResolution(element) > anime::TranslateResolution(condition.value);
-        } else {
-          return CompareStrings(element, condition.value) > 0;
-        }
-      }
+      return element > value;
     case kFeedFilterOperator_IsGreaterThanOrEqualTo:
-      if (is_numeric) {
-        return ToInt(element) >= ToInt(value);
-      } else {
-        if (condition.element == kFeedFilterElement_Episode_VideoResolution) {
-          return anime::TranslateResolution(element) >= anime::TranslateResolution(condition.value);
-        } else {
-          return CompareStrings(element, condition.value) >= 0;
-        }
-      }
+      return element >= value;
     case kFeedFilterOperator_IsLessThan:
+      return element < value;
+    case kFeedFilterOperator_IsLessThanOrEqualTo:
+      return element <= value;
+  }
+
+  return false;
+}
+
+static bool IsCharsEqualCaseInsensitive(wchar_t c1, wchar_t c2) {
+  return tolower(c1) == tolower(c2);
+}
+
+// Same as InStr(str, search, 0, true) > -1, without copying the strings
+static bool ContainsString(const std::wstring& str,
+                           const std::wstring& search) {
+  if (str.empty())
+    return false;
+  if (search.empty())
+    return true;
+
+  return std::search(str.begin(), str.end(), search.begin(), search.end(),
+                     &IsCharsEqualCaseInsensitive) != str.end();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FeedItemFeatures::FeedItemFeatures()
+    : anime(nullptr),
+      episode_available(0),
+      episode_number(0),
+      episode_version(0),
+      video_resolution(0) {
+}
+
+void FeedItemFeatures::Build(const FeedItem& item) {
+  const auto& episode = item.episode_data;
+
+  anime = AnimeDatabase.FindItem(episode.anime_id);
+  episode_number = anime::GetEpisodeHigh(episode.number);
+  episode_available = anime ? anime->IsEpisodeAvailable(episode_number) : 0;
+  episode_version = episode.version.empty() ? 1 : ToInt(episode.version);
+  video_resolution = anime::TranslateResolution(episode.resolution);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FeedFilterPredicate::FeedFilterPredicate()
+    : element_(kFeedFilterElement_None),
+      op_(kFeedFilterOperator_Equals),
+      has_variables_(false),
+      is_true_(false),
+      numeric_value_(0),
+      pattern_index_(-1),
+      resolution_value_(0) {
+}
+
+void FeedFilterPredicate::Compile(const FeedFilterCondition& condition) {
+  element_ = condition.element;
+  op_ = condition.op;
+  raw_value_ = condition.value;
+  pattern_index_ = -1;
+
+  // Patterns are compiled by the filter, and taken as they are, because "$"
+  // has a meaning of its own in a pattern
+  if (is_pattern()) {
+    has_variables_ = false;
+    value_ = raw_value_;
+    return;
+  }
+
+  // Values that include variables or functions have to be evaluated for each
+  // item. Others only go through the unescaping steps of ReplaceVariables,
+  // which do not depend on the item.
+  has_variables_ = raw_value_.find_first_of(L"%$") != std::wstring::npos;
+  if (has_variables_) {
+    value_.clear();
+  } else {
+    value_ = ReplaceVariables(raw_value_, anime::Episode());
+  }
+
+  is_true_ = IsEqual(value_, L"True");
+  numeric_value_ = ToInt(value_);
+  resolution_value_ = anime::TranslateResolution(raw_value_);
+}
+
+const std::wstring& FeedFilterPredicate::GetValue(const FeedItem& item,
+                                                  std::wstring& buffer) const {
+  if (!has_variables_)
+    return value_;
+
+  buffer = ReplaceVariables(raw_value_, item.episode_data);
+  return buffer;
+}
+
+bool FeedFilterPredicate::Evaluate(const FeedItem& item) const {
+  std::wstring element_buffer;
+  std::wstring value_buffer;
+
+  int number = 0;
+  bool is_numeric = GetNumericElement(element_, item, number);
+  bool is_resolution =
+      element_ == kFeedFilterElement_Episode_VideoResolution;
+
+  switch (op_) {
+    case kFeedFilterOperator_Equals:
+    case kFeedFilterOperator_NotEquals:
       if (is_numeric) {
-        return ToInt(element) < ToInt(value);
-      } else {
-        if (condition.element == kFeedFilterElement_Episode_VideoResolution) {
-          return anime::TranslateResolution(element) < anime::TranslateResolution(condition.value);
-        } else {
-          return CompareStrings(element, condition.value) < 0;
+        if (has_variables_) {
+          const std::wstring& value = GetValue(item, value_buffer);
+          if (IsEqual(value, L"True"))
+            return number == TRUE;
+          return CompareNumbers(op_, number, ToInt(value));
         }
+        if (is_true_)
+          return number == TRUE;
+        return CompareNumbers(op_, number, numeric_value_);
+      } else if (is_resolution) {
+        return CompareNumbers(op_, item.features.video_resolution,
+                              resolution_value_);
+      } else {
+        bool equal = IsEqual(GetElementText(element_, item, element_buffer),
+                             GetValue(item, value_buffer));
+        return op_ == kFeedFilterOperator_Equals ? equal : !equal;
       }
+    case kFeedFilterOperator_IsGreaterThan:
+    case kFeedFilterOperator_IsGreaterThanOrEqualTo:
+    case kFeedFilterOperator_IsLessThan:
     case kFeedFilterOperator_IsLessThanOrEqualTo:
       if (is_numeric) {
-        return ToInt(element) <= ToInt(value);
+        int value = has_variables_ ?
+            ToInt(GetValue(item, value_buffer)) : numeric_value_;
+        return CompareNumbers(op_, number, value);
+      } else if (is_resolution) {
+        return CompareNumbers(op_, item.features.video_resolution,
+                              resolution_value_);
       } else {
-        if (condition.element == kFeedFilterElement_Episode_VideoResolution) {
-          return anime::TranslateResolution(element) <= anime::TranslateResolution(condition.value);
-        } else {
-          return CompareStrings(element, condition.value) <= 0;
-        }
+        int result = CompareStrings(
+            GetElementText(element_, item, element_buffer), raw_value_);
+        return CompareNumbers(op_, result, 0);
       }
     case kFeedFilterOperator_BeginsWith:
-      return StartsWith(element, value);
+      return StartsWith(GetElementText(element_, item, element_buffer),
+                        GetValue(item, value_buffer));
     case kFeedFilterOperator_EndsWith:
-      return EndsWith(element, value);
+      return EndsWith(GetElementText(element_, item, element_buffer),
+                      GetValue(item, value_buffer));
     case kFeedFilterOperator_Contains:
-      return InStr(element, value, 0, true) > -1;
+      return ContainsString(GetElementText(element_, item, element_buffer),
+                            GetValue(item, value_buffer));
     case kFeedFilterOperator_NotContains:
-      return InStr(element, value, 0, true) == -1;
+      return !ContainsString(GetElementText(element_, item, element_buffer),
+                             GetValue(item, value_buffer));
+    case kFeedFilterOperator_Matches:
+      // Patterns are matched by the filter, all at once for each element
+      return false;
   }
 
   return false;
 }
 
+FeedFilterElement FeedFilterPredicate::element() const {
+  return element_;
+}
+
+bool FeedFilterPredicate::is_pattern() const {
+  return op_ == kFeedFilterOperator_Matches;
+}
+
+int FeedFilterPredicate::pattern_index() const {
+  return pattern_index_;
+}
+
+void FeedFilterPredicate::set_pattern_index(int index) {
+  pattern_index_ = index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Keys are built so that two keys are equal only if IsEqual() would find the
+// items equal, which is what preference filters used to compare.
+
+static std::wstring GetSiblingKeyPart(std::wstring str) {
+  std::transform(str.begin(), str.end(), str.begin(), tolower);
+  return str;
+}
+
+static std::wstring GetSiblingKey(const FeedItem& item, bool by_title) {
+  std::wstring key;
+
+  if (by_title) {
+    key = L"t" + GetSiblingKeyPart(item.episode_data.title);
+  } else {
+    key = L"i" + ToWstr(item.episode_data.anime_id);
+  }
+
+  key += L'\0' + item.episode_data.number;
+  key += L'\0' + GetSiblingKeyPart(item.episode_data.group);
+
+  return key;
+}
+
+void FeedItemSiblings::Build(Feed& feed) {
+  items_.clear();
+
+  // Items that are not in the list are identified by their titles
+  foreach_(it, feed.items) {
+    bool by_title = it->episode_data.anime_id == anime::ID_NOTINLIST;
+    items_[GetSiblingKey(*it, by_title)].push_back(&(*it));
+  }
+}
+
+void FeedItemSiblings::Clear() {
+  items_.clear();
+}
+
+void FeedItemSiblings::Find(const FeedItem& item,
+                            std::vector<FeedItem*>& siblings) const {
+  for (int i = 0; i < 2; i++) {
+    auto it = items_.find(GetSiblingKey(item, i == 1));
+    if (it != items_.end())
+      foreach_c_(sibling, it->second)
+        if (*sibling != &item)
+          siblings.push_back(*sibling);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 FeedFilterCondition::FeedFilterCondition()
@@ -245,7 +408,74 @@ void FeedFilter::AddCondition(FeedFilterElement element,
   conditions.back().value = value;
 }
 
-void FeedFilter::Filter(Feed& feed, FeedItem& item, bool recursive) {
+static bool IsConditionEqual(const FeedFilterCondition& a,
+                             const FeedFilterCondition& b) {
+  return a.element == b.element && a.op == b.op && a.value == b.value;
+}
+
+void FeedFilter::Compile() {
+  // Conditions only change when the user edits the filter, so there is
+  // usually nothing to do here
+  if (compiled_conditions_.size() == conditions.size() &&
+      std::equal(conditions.begin(), conditions.end(),
+                 compiled_conditions_.begin(), &IsConditionEqual))
+    return;
+
+  patterns_.clear();
+  predicates_.resize(conditions.size());
+
+  for (size_t i = 0; i < conditions.size(); i++) {
+    auto& predicate = predicates_.at(i);
+    predicate.Compile(conditions.at(i));
+    if (!predicate.is_pattern())
+      continue;
+
+    // Patterns that refer to the same element are compiled into the same set,
+    // so that the element is scanned only once
+    auto& pattern_set = patterns_[predicate.element()];
+    pattern_set.set_case_insensitive(true);
+    int index = pattern_set.Add(conditions.at(i).value);
+    if (index < 0)
+      LOG(LevelWarning, L"Invalid pattern in filter \"" + name + L"\": " +
+                        conditions.at(i).value);
+    predicate.set_pattern_index(index);
+  }
+
+  compiled_conditions_ = conditions;
+}
+
+bool FeedFilter::EvaluatePredicate(size_t index, const FeedItem& item,
+                                   UINT64* pattern_matches,
+                                   bool* pattern_scanned) const {
+  const auto& predicate = predicates_.at(index);
+
+  if (!predicate.is_pattern())
+    return predicate.Evaluate(item);
+
+  // Invalid patterns never match
+  if (predicate.pattern_index() < 0)
+    return false;
+
+  FeedFilterElement element = predicate.element();
+  if (element <= kFeedFilterElement_None || element >= kFeedFilterElement_Count)
+    return false;
+
+  if (!pattern_scanned[element]) {
+    auto it = patterns_.find(element);
+    if (it == patterns_.end())
+      return false;
+    std::wstring buffer;
+    pattern_matches[element] =
+        it->second.Match(GetElementText(element, item, buffer));
+    pattern_scanned[element] = true;
+  }
+
+  return (pattern_matches[element] &
+          (static_cast<UINT64>(1) << predicate.pattern_index())) != 0;
+}
+
+void FeedFilter::Filter(FeedItem& item, const FeedItemSiblings& siblings,
+                        bool recursive) {
   if (!enabled)
     return;
 
@@ -268,11 +498,14 @@ void FeedFilter::Filter(Feed& feed, FeedItem& item, bool recursive) {
   bool matched = false;
   size_t condition_index = 0;
 
+  UINT64 pattern_matches[kFeedFilterElement_Count] = {0};
+  bool pattern_scanned[kFeedFilterElement_Count] = {false};
+
   switch (match) {
     case kFeedFilterMatchAll:
       matched = true;
-      for (size_t i = 0; i < conditions.size(); i++) {
-        if (!EvaluateCondition(conditions.at(i), item)) {
+      for (size_t i = 0; i < predicates_.size(); i++) {
+        if (!EvaluatePredicate(i, item, pattern_matches, pattern_scanned)) {
           matched = false;
           condition_index = i;
           break;
@@ -281,8 +514,8 @@ void FeedFilter::Filter(Feed& feed, FeedItem& item, bool recursive) {
       break;
     case kFeedFilterMatchAny:
       matched = false;
-      for (size_t i = 0; i < conditions.size(); i++) {
-        if (EvaluateCondition(conditions.at(i), item)) {
+      for (size_t i = 0; i < predicates_.size(); i++) {
+        if (EvaluatePredicate(i, item, pattern_matches, pattern_scanned)) {
           matched = true;
           condition_index = i;
           break;
@@ -313,29 +546,15 @@ void FeedFilter::Filter(Feed& feed, FeedItem& item, bool recursive) {
     case kFeedFilterActionPrefer: {
       if (recursive) {
         if (matched) {
-          foreach_(it, feed.items) {
+          // Find items with the same title, episode number and group
+          std::vector<FeedItem*> items;
+          siblings.Find(item, items);
+          foreach_(it, items) {
             // Do not bother if the item was discarded before
-            if (it->IsDiscarded())
-              continue;
-            // Do not filter the same item again
-            if (it->index == item.index)
-              continue;
-            // Is it the same title?
-            if (it->episode_data.anime_id == anime::ID_NOTINLIST) {
-              if (!IsEqual(it->episode_data.title, item.episode_data.title))
-                continue;
-            } else {
-              if (it->episode_data.anime_id != item.episode_data.anime_id)
-                continue;
-            }
-            // Is it the same episode?
-            if (it->episode_data.number != item.episode_data.number)
-              continue;
-            // Is it the same group?
-            if (!IsEqual(it->episode_data.group, item.episode_data.group))
+            if ((*it)->IsDiscarded())
               continue;
             // Try applying the same filter
-            Filter(feed, *it, false);
+            Filter(**it, siblings, false);
           }
         }
         // Filters are strong if they're limited, weak otherwise
@@ -444,19 +663,31 @@ void FeedFilterManager::Filter(Feed& feed, bool preferences) {
   if (!Settings.GetBool(taiga::kTorrent_Filter_Enabled))
     return;
 
+  foreach_(filter, filters)
+    if (filter->enabled)
+      filter->Compile();
+
+  foreach_(item, feed.items)
+    item->features.Build(*item);
+
+  if (preferences)
+    siblings_.Build(feed);
+
   foreach_(item, feed.items) {
     foreach_(filter, filters) {
       if (preferences != (filter->action == kFeedFilterActionPrefer))
         continue;
-      filter->Filter(feed, *item, true);
+      filter->Filter(*item, siblings_, true);
     }
   }
+
+  siblings_.Clear();
 }
 
 void FeedFilterManager::FilterArchived(Feed& feed) {
   foreach_(item, feed.items) {
     if (!item->IsDiscarded()) {
-      bool found = Aggregator.SearchArchive(item->title);
+      bool found = Aggregator.archive.Contains(item->title);
       if (found) {
         item->state = kFeedItemDiscardedNormal;
 #ifdef _DEBUG
@@ -601,6 +832,7 @@ void FeedFilterManager::InitializeShortcodes() {
   operator_shortcodes_[kFeedFilterOperator_EndsWith] = L"endswith";
   operator_shortcodes_[kFeedFilterOperator_Contains] = L"contains";
   operator_shortcodes_[kFeedFilterOperator_NotContains] = L"notcontains";
+  operator_shortcodes_[kFeedFilterOperator_Matches] = L"matches";
 
   option_shortcodes_[kFeedFilterOptionDefault] = L"default";
   option_shortcodes_[kFeedFilterOptionDeactivate] = L"deactivate";
@@ -701,6 +933,8 @@ std::wstring FeedFilterManager::TranslateOperator(int op) {
       return L"contains";
     case kFeedFilterOperator_NotContains:
       return L"does not contain";
+    case kFeedFilterOperator_Matches:
+      return L"matches";
     default:
       return L"?";
   }
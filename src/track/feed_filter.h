@@ -21,8 +21,11 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "base/regex.h"
+
 enum FeedFilterElement {
   kFeedFilterElement_None = -1,
   kFeedFilterElement_Meta_Id,
@@ -57,6 +60,7 @@ enum FeedFilterOperator {
   kFeedFilterOperator_EndsWith,
   kFeedFilterOperator_Contains,
   kFeedFilterOperator_NotContains,
+  kFeedFilterOperator_Matches,
   kFeedFilterOperator_Count
 };
 
@@ -85,9 +89,30 @@ enum FeedFilterShortcodeType {
   kFeedFilterShortcodeOption
 };
 
+namespace anime {
+class Item;
+}
+
 class Feed;
 class FeedItem;
 
+// Preference filters are applied to other releases of the same episode by the
+// same group. Grouping these items beforehand saves us from comparing each
+// matched item with every other item in the feed.
+
+class FeedItemSiblings {
+public:
+  FeedItemSiblings() {}
+  ~FeedItemSiblings() {}
+
+  void Build(Feed& feed);
+  void Clear();
+  void Find(const FeedItem& item, std::vector<FeedItem*>& siblings) const;
+
+private:
+  std::unordered_map<std::wstring, std::vector<FeedItem*>> items_;
+};
+
 class FeedFilterCondition {
 public:
   FeedFilterCondition();
@@ -103,6 +128,54 @@ public:
   std::wstring value;
 };
 
+// Item data that filter conditions refer to, gathered once for each item
+// before filters are applied.
+
+class FeedItemFeatures {
+public:
+  FeedItemFeatures();
+  ~FeedItemFeatures() {}
+
+  void Build(const FeedItem& item);
+
+  anime::Item* anime;
+  int episode_available;
+  int episode_number;
+  int episode_version;
+  int video_resolution;
+};
+
+// Conditions are compiled into predicates before a feed is filtered, so that
+// values that do not depend on an item are parsed only once.
+
+class FeedFilterPredicate {
+public:
+  FeedFilterPredicate();
+  ~FeedFilterPredicate() {}
+
+  void Compile(const FeedFilterCondition& condition);
+  bool Evaluate(const FeedItem& item) const;
+
+  FeedFilterElement element() const;
+  bool is_pattern() const;
+  int pattern_index() const;
+  void set_pattern_index(int index);
+
+private:
+  const std::wstring& GetValue(const FeedItem& item,
+                               std::wstring& buffer) const;
+
+  FeedFilterElement element_;
+  FeedFilterOperator op_;
+  std::wstring raw_value_;
+  std::wstring value_;
+  bool has_variables_;
+  bool is_true_;
+  int numeric_value_;
+  int pattern_index_;
+  int resolution_value_;
+};
+
 class FeedFilter {
 public:
   FeedFilter();
@@ -111,7 +184,8 @@ public:
   FeedFilter& operator=(const FeedFilter& filter);
 
   void AddCondition(FeedFilterElement element, FeedFilterOperator op, const std::wstring& value);
-  void Filter(Feed& feed, FeedItem& item, bool recursive);
+  void Compile();
+  void Filter(FeedItem& item, const FeedItemSiblings& siblings, bool recursive);
   void Reset();
 
 public:
@@ -124,6 +198,14 @@ public:
 
   std::vector<int> anime_ids;
   std::vector<FeedFilterCondition> conditions;
+
+private:
+  bool EvaluatePredicate(size_t index, const FeedItem& item,
+                         UINT64* pattern_matches, bool* pattern_scanned) const;
+
+  std::vector<FeedFilterCondition> compiled_conditions_;
+  std::map<int, base::RegexSet> patterns_;
+  std::vector<FeedFilterPredicate> predicates_;
 };
 
 class FeedFilterPreset {
@@ -170,6 +252,8 @@ public:
   std::vector<FeedFilterPreset> presets;
 
 private:
+  FeedItemSiblings siblings_;
+
   std::map<int, std::wstring> action_shortcodes_;
   std::map<int, std::wstring> element_shortcodes_;
   std::map<int, std::wstring> match_shortcodes_;
@@ -39,7 +39,8 @@ public:
   bool untouched;
 };
 
-RecognitionEngine::RecognitionEngine() {
+RecognitionEngine::RecognitionEngine()
+    : generation_(0) {
   ReadKeyword(audio_keywords,
       L"2CH, 5.1CH, 5.1, AAC, AC3, DTS, DTS5.1, DTS-ES, DUALAUDIO, DUAL AUDIO, "
       L"FLAC, MP3, OGG, TRUEHD5.1, VORBIS");
@@ -675,6 +676,8 @@ void RecognitionEngine::CleanTitle(std::wstring& title) {
 void RecognitionEngine::UpdateCleanTitles(int anime_id) {
   auto anime_item = AnimeDatabase.FindItem(anime_id);
 
+  generation_++;
+
   clean_titles[anime_id].clear();
 
   // Main title
@@ -703,6 +706,10 @@ void RecognitionEngine::UpdateCleanTitles(int anime_id) {
   }
 }
 
+unsigned int RecognitionEngine::generation() const {
+  return generation_;
+}
+
 void RecognitionEngine::EraseUnnecessary(std::wstring& str) {
   EraseLeft(str, L"the ", true);
   Replace(str, L" the ", L" ", false, true);
@@ -64,6 +64,9 @@ public:
   void CleanTitle(std::wstring& title);
   void UpdateCleanTitles(int anime_id);
 
+  // Incremented whenever clean titles are updated
+  unsigned int generation() const;
+
   std::multimap<int, int, std::greater<int>> GetScores();
 
   // Mapped as <anime_id, score>
@@ -99,6 +102,8 @@ private:
   void ReadKeyword(std::vector<std::wstring>& output, const std::wstring& input);
   size_t TokenizeTitle(const std::wstring& str, const std::wstring& delimiters, std::vector<Token>& tokens);
   bool ValidateEpisodeNumber(anime::Episode& episode);
+
+  unsigned int generation_;
 };
 
 extern RecognitionEngine Meow;
@@ -392,7 +392,10 @@ int AnimeDialog::GetCurrentId() const {
 }
 
 void AnimeDialog::SetCurrentId(int anime_id) {
+  // Keep the image in memory for as long as it is displayed
+  ImageDatabase.Unpin(anime_id_);
   anime_id_ = anime_id;
+  ImageDatabase.Pin(anime_id_);
 
   switch (anime_id_) {
     case anime::ID_NOTINLIST:
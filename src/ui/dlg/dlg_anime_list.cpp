@@ -227,7 +227,7 @@ INT_PTR AnimeListDialog::DialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM
         win::Rect rect_image = rect;
         rect_image.right = rect_image.left + static_cast<int>(rect_image.Height() / 1.4);
         dc.FillRect(rect_image, ui::kColorGray);
-        if (ImageDatabase.Load(anime_id, false, false)) {
+        if (ImageDatabase.Request(anime_id)) {
           auto image = ImageDatabase.GetImage(anime_id);
           int sbm = dc.SetStretchBltMode(HALFTONE);
           dc.StretchBlt(rect_image.left, rect_image.top,
@@ -311,6 +311,7 @@ void AnimeListDialog::OnSize(UINT uMsg, UINT nType, SIZE size) {
       rcWindow.top -= 1;
       rcWindow.bottom += 2;
       listview.SetPosition(nullptr, rcWindow, 0);
+      visible_images_.Update(listview);
     }
   }
 }
@@ -521,6 +522,12 @@ LRESULT AnimeListDialog::OnListNotify(LPARAM lParam) {
       break;
     }
 
+    // Scroll
+    case LVN_ENDSCROLL: {
+      visible_images_.Update(listview);
+      break;
+    }
+
     // Item hover
     case LVN_HOTTRACK: {
       auto lplv = reinterpret_cast<LPNMLISTVIEW>(lParam);
@@ -1102,6 +1109,8 @@ void AnimeListDialog::RefreshList(int index) {
 
   // Show again
   listview.Show(SW_SHOW);
+
+  visible_images_.Update(listview);
 }
 
 void AnimeListDialog::RefreshListItem(int anime_id) {
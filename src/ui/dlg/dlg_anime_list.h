@@ -19,6 +19,7 @@
 #ifndef TAIGA_UI_DLG_ANIME_LIST_H
 #define TAIGA_UI_DLG_ANIME_LIST_H
 
+#include "ui/list.h"
 #include "win/ctrl/win_ctrl.h"
 #include "win/win_dialog.h"
 #include "win/win_gdi.h"
@@ -82,6 +83,7 @@ public:
 private:
   int current_id_;
   int current_status_;
+  VisibleImages visible_images_;
 };
 
 extern AnimeListDialog DlgAnimeList;
@@ -205,6 +205,7 @@ void FeedConditionDialog::ChooseElement(int element_index) {
       ADD_OPERATOR(kFeedFilterOperator_EndsWith);
       ADD_OPERATOR(kFeedFilterOperator_Contains);
       ADD_OPERATOR(kFeedFilterOperator_NotContains);
+      ADD_OPERATOR(kFeedFilterOperator_Matches);
       break;
     default:
       for (int i = 0; i < kFeedFilterOperator_Count; i++) {
@@ -16,13 +16,16 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "base/foreach.h"
 #include "base/process.h"
 #include "base/string.h"
 #include "library/anime.h"
+#include "library/anime_calendar.h"
 #include "library/anime_db.h"
 #include "library/anime_util.h"
 #include "library/history.h"
 #include "library/resource.h"
+#include "sync/manager.h"
 #include "sync/service.h"
 #include "sync/sync.h"
 #include "taiga/announce.h"
@@ -288,6 +291,30 @@ INT_PTR MainDialog::DialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lPara
       toolbar_wm.ShowMenu();
       return TRUE;
     }
+
+    // Collect images that were decoded in the background
+    case WM_TAIGA_IMAGEDECODED: {
+      ImageDatabase.OnDecodeComplete();
+      return TRUE;
+    }
+
+    // Decode images that were replaced by a download
+    case WM_TAIGA_IMAGEDOWNLOADED: {
+      ImageDatabase.Reload(static_cast<int>(wParam));
+      return TRUE;
+    }
+
+    // Add library entries that were parsed in the background
+    case WM_TAIGA_LIBRARYPARSED: {
+      ServiceManager.HandleLibraryEntries();
+      return TRUE;
+    }
+
+    // Apply the results of library updates that were sent in the background
+    case WM_TAIGA_LIBRARYUPDATED: {
+      ServiceManager.HandleLibraryUpdates();
+      return TRUE;
+    }
   }
   
   return DialogProcDefault(hwnd, uMsg, wParam, lParam);
@@ -701,6 +728,25 @@ void MainDialog::UpdateTip() {
       (!CurrentEpisode.number.empty() ? L" #" + CurrentEpisode.number : L"");
   }
 
+  // Series in the list that are expected to air a new episode
+  std::vector<int> airing_today, airing_this_week;
+  AiringCalendar.GetAiringTitles(0, airing_today);
+  AiringCalendar.GetAiringThisWeek(airing_this_week);
+  int today_count = 0, this_week_count = 0;
+  foreach_(it, airing_today) {
+    auto anime_item = AnimeDatabase.FindItem(*it);
+    if (anime_item && anime_item->IsInList())
+      today_count++;
+  }
+  foreach_(it, airing_this_week) {
+    auto anime_item = AnimeDatabase.FindItem(*it);
+    if (anime_item && anime_item->IsInList())
+      this_week_count++;
+  }
+  if (this_week_count > 0)
+    tip += L"\nAiring today: " + ToWstr(today_count) + L" of " +
+           ToWstr(this_week_count) + L" this week";
+
   Taskbar.Modify(tip.c_str());
 }
 
@@ -25,6 +25,10 @@
 #include "win/win_gdi.h"
 
 #define WM_TAIGA_SHOWMENU WM_USER + 1337
+#define WM_TAIGA_IMAGEDECODED WM_USER + 1338
+#define WM_TAIGA_LIBRARYPARSED WM_USER + 1339
+#define WM_TAIGA_IMAGEDOWNLOADED WM_USER + 1340
+#define WM_TAIGA_LIBRARYUPDATED WM_USER + 1341
 
 namespace ui {
 
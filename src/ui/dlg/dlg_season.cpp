@@ -60,7 +60,8 @@ SeasonDialog DlgSeason;
 SeasonDialog::SeasonDialog()
     : group_by(kSeasonGroupByType),
       sort_by(kSeasonSortByTitle),
-      view_as(kSeasonViewAsTiles) {
+      view_as(kSeasonViewAsTiles),
+      visible_images_(true) {
 }
 
 BOOL SeasonDialog::OnInitDialog() {
@@ -113,6 +114,16 @@ INT_PTR SeasonDialog::DialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lPa
     case WM_MOUSEWHEEL: {
       return list_.SendMessage(uMsg, wParam, lParam);
     }
+
+    // Images are only kept in memory while the page is displayed
+    case WM_SHOWWINDOW: {
+      if (wParam) {
+        visible_images_.Update(list_);
+      } else {
+        visible_images_.Clear();
+      }
+      break;
+    }
   }
 
   return DialogProcDefault(hwnd, uMsg, wParam, lParam);
@@ -131,6 +142,7 @@ BOOL SeasonDialog::OnCommand(WPARAM wParam, LPARAM lParam) {
 }
 
 BOOL SeasonDialog::OnDestroy() {
+  visible_images_.Clear();
   return TRUE;
 }
 
@@ -156,6 +168,7 @@ void SeasonDialog::OnSize(UINT uMsg, UINT nType, SIZE size) {
       rcWindow.top += rebar_.GetBarHeight() + ScaleY(win::kControlMargin / 2);
       // Resize list
       list_.SetPosition(nullptr, rcWindow);
+      visible_images_.Update(list_);
     }
   }
 }
@@ -200,6 +213,17 @@ LRESULT SeasonDialog::OnListNotify(LPARAM lParam) {
       break;
     }
 
+    // Scroll
+    case LVN_BEGINSCROLL: {
+      // Items that are still visible will be requested again while painting
+      ImageDatabase.CancelRequests(anime::kImagePriorityVisible);
+      break;
+    }
+    case LVN_ENDSCROLL: {
+      visible_images_.Update(list_);
+      break;
+    }
+
     // Right click
     case NM_RCLICK: {
       LPNMITEMACTIVATE lpnmitem = reinterpret_cast<LPNMITEMACTIVATE>(pnmh);
@@ -294,7 +318,7 @@ LRESULT SeasonDialog::OnListCustomDraw(LPARAM lParam) {
           rect_details.right, rect_image.bottom);
 
       // Draw image
-      if (ImageDatabase.Load(anime_item->GetId(), false, false)) {
+      if (ImageDatabase.Request(anime_item->GetId())) {
         auto image = ImageDatabase.GetImage(anime_item->GetId());
         rect_image = ResizeRect(rect_image,
                                 image->rect.Width(),
@@ -491,8 +515,8 @@ void SeasonDialog::RefreshData(int anime_id) {
     if (!anime_item)
       continue;
 
-    // Download missing image
-    ImageDatabase.Load(*id, true, true);
+    // Download missing image, which is decoded when it is displayed
+    ImageDatabase.Download(*id);
 
     // Get details
     if (anime::MetadataNeedsRefresh(*anime_item))
@@ -598,6 +622,8 @@ void SeasonDialog::RefreshList(bool redraw_only) {
   list_.SetRedraw(TRUE);
   list_.RedrawWindow(nullptr, nullptr, 
                      RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+
+  visible_images_.Update(list_);
 }
 
 void SeasonDialog::RefreshStatus() {
@@ -19,6 +19,7 @@
 #ifndef TAIGA_UI_DLG_SEASON_H
 #define TAIGA_UI_DLG_SEASON_H
 
+#include "ui/list.h"
 #include "win/ctrl/win_ctrl.h"
 #include "win/win_dialog.h"
 
@@ -57,6 +58,7 @@ private:
   } list_;
   win::Rebar rebar_;
   win::Toolbar toolbar_;
+  VisibleImages visible_images_;
 };
 
 extern SeasonDialog DlgSeason;
@@ -21,6 +21,7 @@
 #include "base/foreach.h"
 #include "base/string.h"
 #include "library/history.h"
+#include "library/resource.h"
 #include "sync/manager.h"
 #include "taiga/resource.h"
 #include "taiga/settings.h"
@@ -528,6 +529,8 @@ void SettingsDialog::RefreshCache() {
 
   // Image files
   text = ToWstr(Stats.image_count) + L" item(s), " + ToSizeString(Stats.image_size);
+  text += L" (" + ToSizeString(static_cast<QWORD>(
+      ImageDatabase.stats().resident_bytes)) + L" in memory)";
   page.SetDlgItemText(IDC_STATIC_CACHE2, text.c_str());
 
   // Torrent files
@@ -136,7 +136,7 @@ BOOL TorrentDialog::OnCommand(WPARAM wParam, LPARAM lParam) {
           if (feed_item) {
             feed_item->state = kFeedItemDiscardedNormal;
             list_.SetCheckState(i, FALSE);
-            Aggregator.file_archive.push_back(feed_item->title);
+            Aggregator.archive.Add(feed_item->title);
           }
         }
       }
@@ -236,7 +236,7 @@ LRESULT TorrentDialog::OnNotify(int idCtrl, LPNMHDR pnmh) {
           } else if (answer == L"DiscardTorrent") {
             feed_item->state = kFeedItemDiscardedNormal;
             list_.SetCheckState(lpnmitem->iItem, FALSE);
-            Aggregator.file_archive.push_back(feed_item->title);
+            Aggregator.archive.Add(feed_item->title);
           } else if (answer == L"DiscardTorrents") {
             auto anime_item = AnimeDatabase.FindItem(feed_item->episode_data.anime_id);
             if (anime_item) {
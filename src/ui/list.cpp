@@ -18,12 +18,17 @@
 
 #include "list.h"
 
+#include <map>
+
+#include "base/foreach.h"
 #include "base/string.h"
 #include "base/time.h"
 #include "library/anime_db.h"
+#include "library/resource.h"
 #include "taiga/settings.h"
 
 #include "win/ctrl/win_ctrl.h"
+#include "win/win_gdi.h"
 
 namespace ui {
 
@@ -309,4 +314,64 @@ int CALLBACK ListViewCompareProc(LPARAM lParam1, LPARAM lParam2,
   return return_value * list->GetSortOrder();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+void VisibleImages::Clear() {
+  foreach_(it, anime_ids_)
+    ImageDatabase.Unpin(*it);
+  anime_ids_.clear();
+}
+
+VisibleImages::VisibleImages(bool prefetch)
+    : prefetch_(prefetch) {
+}
+
+void VisibleImages::Update(win::ListView& list) {
+  std::vector<int> anime_ids;
+  std::map<std::pair<LONG, LONG>, int> next_items;  // top, left
+
+  if (list.IsWindow()) {
+    win::Rect rect_client;
+    list.GetClientRect(&rect_client);
+    // Items that are within a page below the visible area are prefetched
+    LONG prefetch_bottom = rect_client.bottom + rect_client.Height();
+
+    // Items are laid out in index order only in details view without groups
+    bool ordered = list.GetView() == LV_VIEW_DETAILS &&
+                   !list.IsGroupViewEnabled();
+    int item_count = list.GetItemCount();
+
+    for (int i = ordered ? list.GetTopIndex() : 0; i < item_count; i++) {
+      win::Rect rect_item, rect;
+      if (!list.GetItemRect(i, &rect_item))
+        continue;
+      int anime_id = static_cast<int>(list.GetItemParam(i));
+      if (rect.Intersect(rect_client, rect_item)) {
+        anime_ids.push_back(anime_id);
+      } else if (rect_item.top >= prefetch_bottom) {
+        if (ordered)
+          break;
+      } else if (prefetch_ && rect_item.top >= rect_client.bottom) {
+        next_items[std::make_pair(rect_item.top, rect_item.left)] = anime_id;
+      }
+    }
+  }
+
+  // New pins are added first, so that images that are still visible are not
+  // evicted in between
+  foreach_(it, anime_ids)
+    ImageDatabase.Pin(*it);
+  Clear();
+  anime_ids_.swap(anime_ids);
+
+  // Prefetch in display order, replacing the requests of the previous range
+  if (prefetch_) {
+    std::vector<int> next_ids;
+    foreach_(it, next_items)
+      next_ids.push_back(it->second);
+    ImageDatabase.CancelRequests(anime::kImagePriorityPrefetch);
+    ImageDatabase.Prefetch(next_ids);
+  }
+}
+
 }  // namespace ui
\ No newline at end of file
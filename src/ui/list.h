@@ -19,8 +19,13 @@
 #ifndef TAIGA_UI_LIST_H
 #define TAIGA_UI_LIST_H
 
+#include <vector>
 #include <windows.h>
 
+namespace win {
+class ListView;
+}
+
 namespace ui {
 
 enum ListSortType {
@@ -39,6 +44,23 @@ enum ListSortType {
 int CALLBACK ListViewCompareProc(LPARAM lParam1, LPARAM lParam2,
                                  LPARAM lParamSort);
 
+// Keeps the images of the items that are visible in a list view pinned in
+// memory, so that they are not evicted while they are displayed. Update must
+// be called whenever the visible range may have changed. If enabled, images of
+// the items that are about to be scrolled into view are prefetched as well.
+
+class VisibleImages {
+public:
+  explicit VisibleImages(bool prefetch = false);
+
+  void Clear();
+  void Update(win::ListView& list);
+
+private:
+  std::vector<int> anime_ids_;
+  bool prefetch_;
+};
+
 }  // namespace ui
 
 #endif  // TAIGA_UI_LIST_H
\ No newline at end of file
@@ -98,10 +98,13 @@ void OnHttpError(const taiga::HttpClient& http_client, const string_t& error) {
       break;
     case taiga::kHttpFeedCheck:
     case taiga::kHttpFeedCheckAuto:
+      ChangeStatusText(error);
+      DlgTorrent.EnableInput();
+      break;
     case taiga::kHttpFeedDownload:
     case taiga::kHttpFeedDownloadAll:
+      // Input is enabled when the other downloads are complete
       ChangeStatusText(error);
-      DlgTorrent.EnableInput();
       break;
     case taiga::kHttpTwitterRequest:
     case taiga::kHttpTwitterAuth:
@@ -216,6 +219,7 @@ void OnLibraryChange() {
   DlgSearch.RefreshList();
 
   DlgMain.EnableInput(true);
+  DlgMain.UpdateTip();
 }
 
 void OnLibraryChangeFailure() {
@@ -670,11 +674,16 @@ void OnFeedCheck(bool success) {
   DlgTorrent.EnableInput();
 }
 
-void OnFeedDownload(bool success) {
-  if (success)
+void OnFeedDownload(int succeeded, int failed) {
+  if (succeeded > 0)
     DlgTorrent.RefreshList();
 
-  ChangeStatusText(L"Successfully downloaded all torrents.");
+  if (failed == 0) {
+    ChangeStatusText(L"Successfully downloaded all torrents.");
+  } else {
+    ChangeStatusText(L"Downloaded " + ToWstr(succeeded) + L" of " +
+                     ToWstr(succeeded + failed) + L" torrents.");
+  }
   DlgTorrent.EnableInput();
 }
 
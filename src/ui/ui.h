@@ -81,7 +81,7 @@ void OnSettingsThemeChange();
 void OnSettingsUserChange();
 
 void OnFeedCheck(bool success);
-void OnFeedDownload(bool success);
+void OnFeedDownload(int succeeded, int failed);
 bool OnFeedNotify(const Feed& feed);
 
 void OnMircNotRunning(bool testing = false);
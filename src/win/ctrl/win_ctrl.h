@@ -126,6 +126,7 @@ public:
   HWND       GetHeader();
   int        GetItemCount();
   LPARAM     GetItemParam(int i);
+  BOOL       GetItemRect(int item, LPRECT rect, int code = LVIR_BOUNDS);
   void       GetItemText(int item, int subitem, LPWSTR output, int max_length = MAX_PATH);
   void       GetItemText(int item, int subitem, std::wstring& output, int max_length = MAX_PATH);
   INT        GetNextItem(int start, UINT flags);
@@ -136,6 +137,7 @@ public:
   int        GetSortOrder();
   int        GetSortType();
   BOOL       GetSubItemRect(int item, int subitem, LPRECT rect);
+  int        GetTopIndex();
   DWORD      GetView();
   int        HitTest(bool return_subitem = false);
   int        HitTestEx(LPLVHITTESTINFO lplvhi);
@@ -145,6 +145,10 @@ LPARAM ListView::GetItemParam(int i) {
   }
 }
 
+BOOL ListView::GetItemRect(int item, LPRECT rect, int code) {
+  return ListView_GetItemRect(window_, item, rect, code);
+}
+
 void ListView::GetItemText(int item, int subitem,
                            LPWSTR output, int max_length) {
   ListView_GetItemText(window_, item, subitem, output, max_length);
@@ -185,6 +189,10 @@ BOOL ListView::GetSubItemRect(int item, int subitem, LPRECT rect) {
   return ListView_GetSubItemRect(window_, item, subitem, LVIR_BOUNDS, rect);
 }
 
+int ListView::GetTopIndex() {
+  return ListView_GetTopIndex(window_);
+}
+
 DWORD ListView::GetView() {
   return ListView_GetView(window_);
 }
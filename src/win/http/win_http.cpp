@@ -59,31 +59,57 @@ Client::Client()
       content_length_(0),
       current_length_(0),
       curl_handle_(nullptr),
+      transfer_state_(kTransferIdle),
+      transfer_result_(CURLE_OK),
+      cancel_event_(::CreateEvent(nullptr, FALSE, FALSE, nullptr)),
+      cancelled_(false),
+      completion_event_(::CreateEvent(nullptr, TRUE, TRUE, nullptr)),
+      completion_thread_id_(0),
       header_list_(nullptr),
-      secure_transaction_(false) {
+      secure_transaction_(false),
+      sink_type_(kSinkText) {
   user_agent_ = L"Mozilla/5.0";
 }
 
 Client::~Client() {
   Cleanup();
+
+  if (cancel_event_)
+    ::CloseHandle(cancel_event_);
+  if (completion_event_)
+    ::CloseHandle(completion_event_);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool Client::Cancel() {
+  return session_.Cancel(this);
+}
+
+void Client::ConfigurePool(unsigned int idle_timeout,
+                           unsigned int max_pool_size,
+                           unsigned int max_host_connections) {
+  session_.Configure(idle_timeout, max_pool_size, max_host_connections);
+}
+
 void Client::Cleanup() {
+  // Take the transfer back from the connection thread
+  if (transfer_state_ == kTransferRunning)
+    session_.Cancel(this);
+
+  // A transfer that could not be cancelled may still be completing on the
+  // thread pool, and its handle and buffers must not be released under it
+  session_.WaitForCompletion(this);
+
   // Close handles
   if (curl_handle_) {
-    curl_easy_cleanup(curl_handle_);
+    session_.ReleaseHandle(request_.host, curl_handle_);
     curl_handle_ = nullptr;
   }
   if (header_list_) {
     curl_slist_free_all(header_list_);
     header_list_ = nullptr;
   }
-  if (GetThreadHandle() &&
-      GetThreadId() != GetCurrentThreadId()) {
-    CloseThreadHandle();
-  }
 
   // Clear request and response
   request_.Clear();
@@ -91,7 +117,10 @@ void Client::Cleanup() {
 
   // Clear buffers
   optional_data_.clear();
-  write_buffer_.clear();
+  decoded_buffer_.clear();
+  gzip_decoder_.Reset();
+  buffer_sink_.Clear();
+  file_sink_.Clear();
 
   // Reset variables
   content_encoding_ = kContentEncodingNone;
@@ -109,6 +138,18 @@ const Response& Client::response() const {
   return response_;
 }
 
+const std::string& Client::write_buffer() const {
+  return buffer_sink_.buffer();
+}
+
+bool Client::busy() const {
+  return transfer_state_ != kTransferIdle;
+}
+
+SinkType Client::sink_type() const {
+  return sink_type_;
+}
+
 curl_off_t Client::content_length() const {
   return content_length_;
 }
@@ -123,6 +164,8 @@ void Client::set_auto_redirect(bool enabled) {
 
 void Client::set_download_path(const std::wstring& download_path) {
   download_path_ = download_path;
+  file_sink_.set_path(download_path);
+  sink_type_ = download_path.empty() ? kSinkText : kSinkFile;
 
   // Make sure the path is available
   if (!download_path.empty())
@@ -141,13 +184,27 @@ void Client::set_referer(const std::wstring& referer) {
   referer_ = referer;
 }
 
+void Client::set_sink_type(SinkType sink_type) {
+  sink_type_ = sink_type;
+}
+
 void Client::set_user_agent(const std::wstring& user_agent) {
   user_agent_ = user_agent;
 }
 
+Sink& Client::sink() {
+  if (sink_type_ == kSinkFile)
+    return file_sink_;
+
+  return buffer_sink_;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
+// The session is defined after the global state of curl, so that it is
+// destroyed before curl is cleaned up
 CurlGlobal Client::curl_global_;
+Session Client::session_;
 
 CurlGlobal::CurlGlobal()
     : initialized_(false) {
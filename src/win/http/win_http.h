@@ -29,9 +29,11 @@
 #endif
 
 #include <windows.h>
+#include <map>
 #include <string>
 #include <vector>
 
+#include "base/gzip.h"
 #include "base/map.h"
 #include "third_party/curl/curl.h"
 #include "win/win_thread.h"
@@ -44,6 +46,7 @@ typedef base::multimap<std::wstring, std::wstring> query_t;
 
 enum ContentEncoding {
   kContentEncodingNone,
+  kContentEncodingDeflate,
   kContentEncodingGzip
 };
 
@@ -52,6 +55,12 @@ enum Protocol {
   kHttps
 };
 
+enum SinkType {
+  kSinkText,  // Decoded into the body of the response
+  kSinkRaw,   // Kept as bytes, see Client::write_buffer
+  kSinkFile   // Written to the download path
+};
+
 class Request {
 public:
   Request();
@@ -86,6 +95,55 @@ public:
   LPARAM parameter;
 };
 
+// Response data is written to a sink as it arrives.
+
+class Sink {
+public:
+  virtual ~Sink() {}
+
+  virtual void Clear() = 0;
+  virtual bool Finish(bool success) = 0;
+  virtual bool Write(const char* data, size_t size) = 0;
+};
+
+class BufferSink : public Sink {
+public:
+  BufferSink() {}
+  ~BufferSink() {}
+
+  void Clear();
+  bool Finish(bool success);
+  bool Write(const char* data, size_t size);
+
+  const std::string& buffer() const;
+
+private:
+  std::string buffer_;
+};
+
+// Files are created when the first chunk of data arrives, so that an existing
+// file is left alone if there is nothing to write (e.g. "304 Not Modified").
+// Incomplete files are deleted.
+
+class FileSink : public Sink {
+public:
+  FileSink();
+  ~FileSink();
+
+  void Clear();
+  bool Finish(bool success);
+  bool Write(const char* data, size_t size);
+
+  const std::wstring& path() const;
+  void set_path(const std::wstring& path);
+
+private:
+  void Close();
+
+  HANDLE file_handle_;
+  std::wstring path_;
+};
+
 class CurlGlobal {
 public:
   CurlGlobal();
@@ -97,16 +155,105 @@ private:
   bool initialized_;
 };
 
-class Client : public win::Thread {
+class Client;
+
+// Transfers of all clients are driven by a single connection thread, through
+// a curl multi handle. Requests are submitted through a lock-free queue, so
+// that submitting never waits for the connection thread, and clients are
+// notified of complete transfers on the system thread pool.
+//
+// Connections are kept alive between requests. Easy handles are pooled for
+// each host, and the DNS cache, TLS sessions and cookies are shared between
+// all handles. Connections are closed after the session has been idle for a
+// while.
+
+class Session : public win::Thread {
+public:
+  Session();
+  ~Session();
+
+  bool Add(Client* client);
+  bool Cancel(Client* client);
+  void WaitForCompletion(Client* client);
+  void Configure(unsigned int idle_timeout, unsigned int max_pool_size,
+                 unsigned int max_host_connections);
+  void Shutdown();
+
+  CURL* AcquireHandle(const std::wstring& host);
+  void ReleaseHandle(const std::wstring& host, CURL* handle);
+  CURLSH* share_handle() const;
+
+  DWORD ThreadProc();
+
+private:
+  class Message {
+  public:
+    SLIST_ENTRY entry;  // Must be the first member
+    Client* client;
+    bool cancel;
+  };
+
+  class PooledHandle {
+  public:
+    CURL* handle;
+    DWORD release_time;
+  };
+
+  static DWORD WINAPI CompletionProc(LPVOID parameter);
+  static void LockFunction(CURL*, curl_lock_data, curl_lock_access, void*);
+  static void UnlockFunction(CURL*, curl_lock_data, void*);
+
+  void CloseIdleConnections();
+  bool CreateMultiHandle();
+  void Dispatch(Client* client, CURLcode result);
+  bool Post(Client* client, bool cancel);
+  void ProcessCompletions();
+  void ProcessMessages();
+  bool RemoveTransfer(Client* client);
+  bool Start();
+  void TrimPool(DWORD max_idle_time);
+
+  win::CriticalSection critical_section_;
+  CURLM* multi_handle_;
+  SLIST_HEADER messages_;
+  std::map<CURL*, Client*> transfers_;
+  HANDLE wake_event_;
+  volatile LONG started_;
+  volatile bool shutdown_;
+
+  CURLSH* share_handle_;
+  win::CriticalSection share_critical_sections_[CURL_LOCK_DATA_LAST];
+
+  std::map<std::wstring, std::vector<PooledHandle>> pool_;
+  win::CriticalSection pool_critical_section_;
+  size_t pool_size_;
+  DWORD idle_timeout_;  // milliseconds
+  unsigned int max_pool_size_;
+  unsigned int max_host_connections_;
+  bool idle_connections_;
+  DWORD last_transfer_time_;
+};
+
+class Client {
 public:
+  friend class Session;
+
   Client();
   virtual ~Client();
 
+  bool Cancel();
   void Cleanup();
   bool MakeRequest(Request request);
 
+  static void ConfigurePool(unsigned int idle_timeout,
+                            unsigned int max_pool_size,
+                            unsigned int max_host_connections);
+
   const Request& request() const;
   const Response& response() const;
+  const std::string& write_buffer() const;
+  bool busy() const;
+  SinkType sink_type() const;
   curl_off_t content_length() const;
   curl_off_t current_length() const;
 
@@ -117,6 +264,7 @@ public:
       const std::wstring& username,
       const std::wstring& password);
   void set_referer(const std::wstring& referer);
+  void set_sink_type(SinkType sink_type);
   void set_user_agent(const std::wstring& user_agent);
 
   virtual void OnError(CURLcode error_code) {}
@@ -125,8 +273,6 @@ public:
   virtual bool OnReadComplete() { return true; }  // TODO: Why "true"?
   virtual bool OnRedirect(const std::wstring& address) { return false; }
 
-  DWORD ThreadProc();
-
 protected:
   Request request_;
   Response response_;
@@ -134,7 +280,8 @@ protected:
   ContentEncoding content_encoding_;
   curl_off_t content_length_;
   curl_off_t current_length_;
-  std::string write_buffer_;
+  std::string decoded_buffer_;
+  GzipDecoder gzip_decoder_;
 
   bool auto_redirect_;
   std::wstring download_path_;
@@ -146,26 +293,52 @@ protected:
   std::wstring user_agent_;
 
 private:
+  // Clients own their events and transfers, so they cannot be copied
+  Client(const Client&);
+  Client& operator=(const Client&);
+
   static size_t HeaderFunction(void*, size_t, size_t, void*);
   static size_t WriteFunction(char*, size_t, size_t, void*);
   static int DebugCallback(CURL*, curl_infotype, char*, size_t, void*);
   static int XferInfoFunction(void*, curl_off_t, curl_off_t, curl_off_t, curl_off_t);
   int ProgressFunction(curl_off_t, curl_off_t);
+  bool WriteData(const char* data, size_t size);
+
+  Sink& sink();
 
   bool Initialize();
   bool SetRequestOptions();
   bool SendRequest();
   bool Perform();
+  bool Complete(CURLcode code);
 
   void BuildRequestHeader();
   bool GetResponseHeader(const std::wstring& header);
   bool ParseResponseHeader();
 
   static CurlGlobal curl_global_;
+  static Session session_;
   CURL* curl_handle_;
 
+  // The transfer is owned by the connection thread while it is running
+  enum TransferState {
+    kTransferIdle,
+    kTransferRunning,
+    kTransferCompleting
+  };
+  volatile LONG transfer_state_;
+  CURLcode transfer_result_;
+  HANDLE cancel_event_;
+  bool cancelled_;
+  HANDLE completion_event_;
+  volatile DWORD completion_thread_id_;
+
   curl_slist* header_list_;
   std::string optional_data_;
+
+  BufferSink buffer_sink_;
+  FileSink file_sink_;
+  SinkType sink_type_;
 };
 
 class Url {
@@ -52,11 +52,33 @@ size_t Client::WriteFunction(char* ptr, size_t size, size_t nmemb,
 
   size_t data_size = size * nmemb;
 
-  reinterpret_cast<std::string*>(userdata)->append(ptr, data_size);
+  auto client = reinterpret_cast<Client*>(userdata);
+
+  // Returning a different size aborts the transfer
+  if (!client->WriteData(ptr, data_size))
+    return 0;
 
   return data_size;
 }
 
+bool Client::WriteData(const char* data, size_t size) {
+  // Compressed data is decoded as it arrives. The buffer is reused for each
+  // chunk, so only the decoded data of a single chunk is held in memory. The
+  // decoder detects both gzip and zlib (i.e. deflate) headers.
+  if (content_encoding_ != kContentEncodingNone) {
+    decoded_buffer_.clear();
+    if (!gzip_decoder_.Decode(data, size, decoded_buffer_)) {
+      LOG(LevelError, L"Could not decode compressed data.");
+      return false;
+    }
+    if (decoded_buffer_.empty())
+      return true;
+    return sink().Write(decoded_buffer_.data(), decoded_buffer_.size());
+  }
+
+  return sink().Write(data, size);
+}
+
 int Client::ProgressFunction(curl_off_t dltotal, curl_off_t dlnow) {
   if (response_.header.empty())
     return 0;
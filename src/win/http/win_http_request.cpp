@@ -21,7 +21,6 @@
 #include "base/encoding.h"
 #include "base/file.h"
 #include "base/foreach.h"
-#include "base/gzip.h"
 #include "base/logger.h"
 #include "base/string.h"
 
@@ -58,7 +57,8 @@ bool Client::Initialize() {
   if (!curl_global_.initialized())
     return false;
 
-  curl_handle_ = curl_easy_init();
+  // Handles are reused, so that connections to the same host are kept alive
+  curl_handle_ = session_.AcquireHandle(request_.host);
 
   return curl_handle_ != nullptr;
 }
@@ -85,7 +85,7 @@ bool Client::SetRequestOptions() {
   TAIGA_CURL_SET_OPTION(CURLOPT_HEADERDATA, this);
 
   TAIGA_CURL_SET_OPTION(CURLOPT_WRITEFUNCTION, WriteFunction);
-  TAIGA_CURL_SET_OPTION(CURLOPT_WRITEDATA, &write_buffer_);
+  TAIGA_CURL_SET_OPTION(CURLOPT_WRITEDATA, this);
 
   TAIGA_CURL_SET_OPTION(CURLOPT_NOPROGRESS, FALSE);
   TAIGA_CURL_SET_OPTION(CURLOPT_XFERINFOFUNCTION, XferInfoFunction);
@@ -125,6 +125,13 @@ bool Client::SetRequestOptions() {
   TAIGA_CURL_SET_OPTION(CURLOPT_PROTOCOLS, protocol);
   TAIGA_CURL_SET_OPTION(CURLOPT_REDIR_PROTOCOLS, protocol);
 
+  // Share the DNS cache, TLS sessions and cookies with other handles
+  if (session_.share_handle()) {
+    TAIGA_CURL_SET_OPTION(CURLOPT_SHARE, session_.share_handle());
+  }
+  // Enable the cookie engine, without reading cookies from a file
+  TAIGA_CURL_SET_OPTION(CURLOPT_COOKIEFILE, "");
+
   // Set proxy
   if (!proxy_host_.empty()) {
     std::string proxy_host = WstrToStr(proxy_host_);
@@ -188,30 +195,25 @@ bool Client::SetRequestOptions() {
 
 bool Client::SendRequest() {
 #ifdef TAIGA_WIN_HTTP_MULTITHREADED
-  return CreateThread(nullptr, 0, 0);
+  return session_.Add(this);
 #else
   return Perform();
 #endif
 }
 
-
-
 bool Client::Perform() {
   CURLcode code = curl_easy_perform(curl_handle_);
 
-  if (code == CURLE_OK) {
-    if (!write_buffer_.empty()) {
-      if (content_encoding_ == kContentEncodingGzip) {
-        std::string compressed;
-        std::swap(write_buffer_, compressed);
-        UncompressGzippedString(compressed, write_buffer_);
-      }
-      response_.body = StrToWstr(write_buffer_);
-    }
+  return Complete(code);
+}
+
+bool Client::Complete(CURLcode code) {
+  sink().Finish(code == CURLE_OK);
 
-    if (!download_path_.empty())
-      SaveToFile((LPCVOID)&write_buffer_.front(), write_buffer_.size(),
-                 download_path_);
+  if (code == CURLE_OK) {
+    // Binary data (e.g. images) is never converted to text
+    if (sink_type_ == kSinkText && !buffer_sink_.buffer().empty())
+      response_.body = StrToWstr(buffer_sink_.buffer());
 
     if (!OnReadComplete())
       return true;
@@ -225,10 +227,6 @@ bool Client::Perform() {
   return code == CURLE_OK;
 }
 
-DWORD Client::ThreadProc() {
-  return Perform();
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 
 void Client::BuildRequestHeader() {
@@ -61,6 +61,8 @@ bool Client::ParseResponseHeader() {
     if (IsEqual(name, L"Content-Encoding")) {
       if (InStr(value, L"gzip") > -1) {
         content_encoding_ = kContentEncodingGzip;
+      } else if (InStr(value, L"deflate") > -1) {
+        content_encoding_ = kContentEncodingDeflate;
       } else {
         content_encoding_ = kContentEncodingNone;
       }
@@ -83,6 +85,8 @@ bool Client::ParseResponseHeader() {
     request_.host = location.host;
     request_.path = location.path;
     response_.Clear();
+    gzip_decoder_.Reset();
+    sink().Clear();
   }
 
   return true;
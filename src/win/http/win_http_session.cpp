@@ -0,0 +1,481 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <malloc.h>
+
+#include "win_http.h"
+
+#include "base/foreach.h"
+#include "base/logger.h"
+
+namespace win {
+namespace http {
+
+// Upper limit for each wait of the connection thread, which is also how long
+// it may take for a new request to be picked up while other transfers are
+// running
+const long kMaxWaitTime = 50;  // milliseconds
+
+// Waits for the object, while dispatching messages that are sent from other
+// threads. Callbacks on the connection thread may send messages to windows of
+// the waiting thread, which would otherwise result in a deadlock.
+static void WaitForObject(HANDLE handle, HANDLE thread) {
+  HANDLE handles[] = {handle, thread};
+  DWORD count = thread ? 2 : 1;
+
+  while (::MsgWaitForMultipleObjects(count, handles, FALSE, INFINITE,
+                                     QS_SENDMESSAGE) == WAIT_OBJECT_0 + count) {
+    MSG msg;
+    ::PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE);
+  }
+}
+
+Session::Session()
+    : multi_handle_(nullptr),
+      wake_event_(nullptr),
+      started_(0),
+      shutdown_(false),
+      share_handle_(nullptr),
+      pool_size_(0),
+      idle_timeout_(30 * 1000),
+      max_pool_size_(10),
+      max_host_connections_(6),
+      idle_connections_(false),
+      last_transfer_time_(0) {
+  ::InitializeSListHead(&messages_);
+}
+
+Session::~Session() {
+  Shutdown();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Session::Add(Client* client) {
+  if (!Start())
+    return false;
+
+  ::InterlockedExchange(&client->transfer_state_, Client::kTransferRunning);
+
+  if (!Post(client, false)) {
+    ::InterlockedExchange(&client->transfer_state_, Client::kTransferIdle);
+    return false;
+  }
+
+  return true;
+}
+
+// Returns true if the transfer was running and has been stopped, and false if
+// it was already complete
+bool Session::Cancel(Client* client) {
+  if (client->transfer_state_ != Client::kTransferRunning)
+    return false;
+
+  client->cancelled_ = false;
+
+  if (::GetCurrentThreadId() == GetThreadId()) {
+    client->cancelled_ = RemoveTransfer(client);
+    if (client->cancelled_)
+      ::InterlockedExchange(&client->transfer_state_, Client::kTransferIdle);
+  } else if (Post(client, true)) {
+    // The thread handle is included, in case the session is shut down before
+    // the message is processed
+    WaitForObject(client->cancel_event_, GetThreadHandle());
+  }
+
+  return client->cancelled_;
+}
+
+// Blocks until the completion handler of the transfer has returned. Handlers
+// clean up their own clients, so there is nothing to wait for on the thread
+// that runs them.
+void Session::WaitForCompletion(Client* client) {
+  if (client->transfer_state_ != Client::kTransferCompleting)
+    return;
+  if (client->completion_thread_id_ == ::GetCurrentThreadId())
+    return;
+
+  WaitForObject(client->completion_event_, nullptr);
+}
+
+void Session::Configure(unsigned int idle_timeout, unsigned int max_pool_size,
+                        unsigned int max_host_connections) {
+  win::Lock lock(pool_critical_section_);
+
+  // Limits of the multi handle are applied when it is created again, after
+  // idle connections are closed
+  idle_timeout_ = idle_timeout * 1000;
+  max_pool_size_ = max_pool_size;
+  max_host_connections_ = max_host_connections;
+}
+
+void Session::Shutdown() {
+  {
+    win::Lock lock(critical_section_);
+    if (!started_ || shutdown_)
+      return;
+    shutdown_ = true;
+  }
+
+  ::SetEvent(wake_event_);
+  WaitForObject(GetThreadHandle(), nullptr);
+
+  curl_multi_cleanup(multi_handle_);
+  multi_handle_ = nullptr;
+  ::CloseHandle(wake_event_);
+  wake_event_ = nullptr;
+
+  {
+    win::Lock lock(pool_critical_section_);
+    TrimPool(0);
+  }
+
+  // Fails if there are clients that still have their handles, in which case
+  // the shared data is left to be freed by the system
+  if (curl_share_cleanup(share_handle_) == CURLSHE_OK)
+    share_handle_ = nullptr;
+}
+
+bool Session::Start() {
+  if (started_)
+    return !shutdown_;
+
+  win::Lock lock(critical_section_);
+
+  if (started_ || shutdown_)
+    return started_ && !shutdown_;
+
+  // curl must be initialized by now, which is why the handles are not created
+  // in the constructor
+  share_handle_ = curl_share_init();
+  if (share_handle_) {
+    curl_share_setopt(share_handle_, CURLSHOPT_LOCKFUNC, LockFunction);
+    curl_share_setopt(share_handle_, CURLSHOPT_UNLOCKFUNC, UnlockFunction);
+    curl_share_setopt(share_handle_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+    curl_share_setopt(share_handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_handle_, CURLSHOPT_SHARE,
+                      CURL_LOCK_DATA_SSL_SESSION);
+  }
+
+  if (!CreateMultiHandle())
+    return false;
+
+  wake_event_ = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (!wake_event_ || !CreateThread(nullptr, 0, 0)) {
+    LOG(LevelError, L"Could not start the connection thread.");
+    curl_multi_cleanup(multi_handle_);
+    multi_handle_ = nullptr;
+    if (wake_event_) {
+      ::CloseHandle(wake_event_);
+      wake_event_ = nullptr;
+    }
+    return false;
+  }
+
+  ::InterlockedExchange(&started_, 1);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DWORD Session::ThreadProc() {
+  while (true) {
+    ProcessMessages();
+
+    if (shutdown_)
+      break;
+
+    if (transfers_.empty()) {
+      DWORD wait_time = INFINITE;
+      if (idle_connections_) {
+        DWORD idle_time = ::GetTickCount() - last_transfer_time_;
+        if (idle_time >= idle_timeout_) {
+          CloseIdleConnections();
+          continue;
+        }
+        wait_time = idle_timeout_ - idle_time;
+      }
+      ::WaitForSingleObject(wake_event_, wait_time);
+      continue;
+    }
+
+    int running_handles = 0;
+    while (curl_multi_perform(multi_handle_, &running_handles) ==
+           CURLM_CALL_MULTI_PERFORM);
+
+    ProcessCompletions();
+
+    if (transfers_.empty())
+      continue;
+
+    long timeout = -1;
+    curl_multi_timeout(multi_handle_, &timeout);
+    if (timeout < 0 || timeout > kMaxWaitTime)
+      timeout = kMaxWaitTime;
+
+    if (timeout > 0) {
+      int numfds = 0;
+      curl_multi_wait(multi_handle_, nullptr, 0, timeout, &numfds);
+      // curl_multi_wait returns immediately when there are no sockets to wait
+      // for (e.g. while host names are being resolved)
+      if (numfds == 0)
+        ::WaitForSingleObject(wake_event_, timeout);
+    }
+  }
+
+  // Transfers that are still running are abandoned, and their handles are
+  // cleaned up by their clients
+  foreach_(it, transfers_) {
+    curl_multi_remove_handle(multi_handle_, it->first);
+    ::InterlockedExchange(&it->second->transfer_state_, Client::kTransferIdle);
+  }
+  transfers_.clear();
+
+  ProcessMessages();
+
+  return 0;
+}
+
+CURL* Session::AcquireHandle(const std::wstring& host) {
+  // Shared data is created when the session is started
+  Start();
+
+  CURL* handle = nullptr;
+
+  {
+    win::Lock lock(pool_critical_section_);
+    auto it = pool_.find(host);
+    if (it != pool_.end() && !it->second.empty()) {
+      handle = it->second.back().handle;
+      it->second.pop_back();
+      pool_size_--;
+    }
+  }
+
+  if (!handle)
+    handle = curl_easy_init();
+
+  return handle;
+}
+
+void Session::ReleaseHandle(const std::wstring& host, CURL* handle) {
+  if (!handle)
+    return;
+
+  // Options are reset, while caches and the shared data are kept
+  curl_easy_reset(handle);
+
+  {
+    win::Lock lock(pool_critical_section_);
+    if (!shutdown_ && idle_timeout_ > 0) {
+      TrimPool(idle_timeout_);
+      auto& handles = pool_[host];
+      if (pool_size_ < max_pool_size_ &&
+          handles.size() < max_host_connections_) {
+        PooledHandle pooled_handle;
+        pooled_handle.handle = handle;
+        pooled_handle.release_time = ::GetTickCount();
+        handles.push_back(pooled_handle);
+        pool_size_++;
+        return;
+      }
+    }
+  }
+
+  curl_easy_cleanup(handle);
+}
+
+CURLSH* Session::share_handle() const {
+  return share_handle_;
+}
+
+void Session::CloseIdleConnections() {
+  {
+    win::Lock lock(pool_critical_section_);
+    TrimPool(0);
+  }
+
+  // Idle connections belong to the multi handle, and this version of curl
+  // provides no other way to close them
+  curl_multi_cleanup(multi_handle_);
+  multi_handle_ = nullptr;
+  CreateMultiHandle();
+
+  idle_connections_ = false;
+}
+
+bool Session::CreateMultiHandle() {
+  multi_handle_ = curl_multi_init();
+  if (!multi_handle_)
+    return false;
+
+  win::Lock lock(pool_critical_section_);
+
+  long max_connections = max(static_cast<long>(max_pool_size_), 1L);
+  curl_multi_setopt(multi_handle_, CURLMOPT_MAXCONNECTS, max_connections);
+  curl_multi_setopt(multi_handle_, CURLMOPT_MAX_HOST_CONNECTIONS,
+                    static_cast<long>(max_host_connections_));
+
+  return true;
+}
+
+void Session::TrimPool(DWORD max_idle_time) {
+  DWORD now = ::GetTickCount();
+
+  foreach_(it, pool_) {
+    auto& handles = it->second;
+    for (auto handle = handles.begin(); handle != handles.end(); ) {
+      if (now - handle->release_time >= max_idle_time) {
+        curl_easy_cleanup(handle->handle);
+        handle = handles.erase(handle);
+        pool_size_--;
+      } else {
+        ++handle;
+      }
+    }
+  }
+}
+
+void Session::LockFunction(CURL* handle, curl_lock_data data,
+                           curl_lock_access access, void* userptr) {
+  auto session = reinterpret_cast<Session*>(userptr);
+  if (data >= 0 && data < CURL_LOCK_DATA_LAST)
+    session->share_critical_sections_[data].Enter();
+}
+
+void Session::UnlockFunction(CURL* handle, curl_lock_data data,
+                             void* userptr) {
+  auto session = reinterpret_cast<Session*>(userptr);
+  if (data >= 0 && data < CURL_LOCK_DATA_LAST)
+    session->share_critical_sections_[data].Leave();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DWORD WINAPI Session::CompletionProc(LPVOID parameter) {
+  Client* client = reinterpret_cast<Client*>(parameter);
+
+  client->completion_thread_id_ = ::GetCurrentThreadId();
+  client->Complete(client->transfer_result_);
+
+  // The handler may have started a new transfer with the same client, in
+  // which case the state belongs to that transfer
+  ::InterlockedCompareExchange(&client->transfer_state_,
+                               Client::kTransferIdle,
+                               Client::kTransferCompleting);
+  client->completion_thread_id_ = 0;
+  ::SetEvent(client->completion_event_);
+
+  return 0;
+}
+
+void Session::Dispatch(Client* client, CURLcode result) {
+  client->transfer_result_ = result;
+  client->completion_thread_id_ = 0;
+  ::ResetEvent(client->completion_event_);
+  ::InterlockedExchange(&client->transfer_state_, Client::kTransferCompleting);
+
+  // Handlers may take a while (e.g. to parse a feed), so they are run on the
+  // thread pool rather than on the connection thread
+  if (!::QueueUserWorkItem(CompletionProc, client, WT_EXECUTEDEFAULT))
+    CompletionProc(client);
+}
+
+bool Session::Post(Client* client, bool cancel) {
+  Message* message = static_cast<Message*>(
+      _aligned_malloc(sizeof(Message), MEMORY_ALLOCATION_ALIGNMENT));
+  if (!message)
+    return false;
+
+  message->client = client;
+  message->cancel = cancel;
+  ::InterlockedPushEntrySList(&messages_, &message->entry);
+  ::SetEvent(wake_event_);
+
+  return true;
+}
+
+void Session::ProcessCompletions() {
+  CURLMsg* msg = nullptr;
+  int msgs_in_queue = 0;
+
+  while ((msg = curl_multi_info_read(multi_handle_, &msgs_in_queue))) {
+    if (msg->msg != CURLMSG_DONE)
+      continue;
+
+    auto it = transfers_.find(msg->easy_handle);
+    if (it == transfers_.end())
+      continue;
+
+    // The message is freed when the handle is removed
+    Client* client = it->second;
+    CURLcode result = msg->data.result;
+    RemoveTransfer(client);
+    Dispatch(client, result);
+  }
+}
+
+void Session::ProcessMessages() {
+  PSLIST_ENTRY entry = ::InterlockedFlushSList(&messages_);
+
+  // Messages are flushed in the reverse order of posting
+  std::vector<Message*> messages;
+  for ( ; entry; entry = entry->Next)
+    messages.push_back(reinterpret_cast<Message*>(entry));
+
+  for (auto it = messages.rbegin(); it != messages.rend(); ++it) {
+    Message* message = *it;
+    Client* client = message->client;
+
+    if (message->cancel) {
+      client->cancelled_ = RemoveTransfer(client);
+      if (client->cancelled_)
+        ::InterlockedExchange(&client->transfer_state_, Client::kTransferIdle);
+      ::SetEvent(client->cancel_event_);
+    } else if (shutdown_) {
+      ::InterlockedExchange(&client->transfer_state_, Client::kTransferIdle);
+    } else if (curl_multi_add_handle(multi_handle_, client->curl_handle_) ==
+               CURLM_OK) {
+      transfers_[client->curl_handle_] = client;
+    } else {
+      Dispatch(client, CURLE_FAILED_INIT);
+    }
+
+    _aligned_free(message);
+  }
+}
+
+bool Session::RemoveTransfer(Client* client) {
+  auto it = transfers_.find(client->curl_handle_);
+  if (it == transfers_.end())
+    return false;
+
+  curl_multi_remove_handle(multi_handle_, it->first);
+  transfers_.erase(it);
+
+  // The connection is kept alive for later requests
+  idle_connections_ = true;
+  last_transfer_time_ = ::GetTickCount();
+
+  return true;
+}
+
+}  // namespace http
+}  // namespace win
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*
+** Taiga
+** Copyright (C) 2010-2014, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "win_http.h"
+
+#include "base/file.h"
+#include "base/logger.h"
+
+namespace win {
+namespace http {
+
+void BufferSink::Clear() {
+  buffer_.clear();
+}
+
+bool BufferSink::Finish(bool success) {
+  return true;
+}
+
+bool BufferSink::Write(const char* data, size_t size) {
+  buffer_.append(data, size);
+  return true;
+}
+
+const std::string& BufferSink::buffer() const {
+  return buffer_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FileSink::FileSink()
+    : file_handle_(INVALID_HANDLE_VALUE) {
+}
+
+FileSink::~FileSink() {
+  Close();
+}
+
+void FileSink::Clear() {
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    Close();
+    ::DeleteFile(path_.c_str());
+  }
+}
+
+bool FileSink::Finish(bool success) {
+  if (success) {
+    Close();
+  } else {
+    Clear();
+  }
+
+  return true;
+}
+
+bool FileSink::Write(const char* data, size_t size) {
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    file_handle_ = OpenFileForGenericWrite(path_);
+    if (file_handle_ == INVALID_HANDLE_VALUE) {
+      LOG(LevelError, L"Could not create file: " + path_);
+      return false;
+    }
+  }
+
+  DWORD bytes_written = 0;
+  if (!::WriteFile(file_handle_, data, static_cast<DWORD>(size),
+                   &bytes_written, nullptr) ||
+      bytes_written != size) {
+    LOG(LevelError, L"Could not write to file: " + path_);
+    return false;
+  }
+
+  return true;
+}
+
+const std::wstring& FileSink::path() const {
+  return path_;
+}
+
+void FileSink::set_path(const std::wstring& path) {
+  Clear();
+  path_ = path;
+}
+
+void FileSink::Close() {
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    ::CloseHandle(file_handle_);
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+}
+
+}  // namespace http
+}  // namespace win
\ No newline at end of file